@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "platform.h"
+#include "evaluator.h"
+
+typedef struct tag_work_queue
+{
+	lock_handle lock;
+	long next;
+	long end;
+} work_queue;
+
+typedef struct tag_batch_worker
+{
+	const batch_config *config;
+	game_result *results;
+	struct tag_batch_worker *workers;
+	int num_workers;
+	int index;
+	thread_handle thread;
+	bool started;
+	search_context search;
+	work_queue queue;
+} batch_worker;
+
+typedef struct tag_policy_entry
+{
+	const char *name;
+	move_policy policy;
+} policy_entry;
+
+const policy_entry policies[] =
+{
+	{ "random", random_policy },
+	{ "greedy", greedy_policy },
+	{ "features", features_policy },
+	{ "lookahead", lookahead_policy }
+};
+
+static bool best_placement(game_state *this_game_state, board_evaluator evaluator,
+	const void *weights, placement *choice);
+static bool parse_weights(const char *text, feature_weights *weights);
+static int compare_ints(const void *a, const void *b);
+static bool take_work(work_queue *queue, long *game);
+static bool steal_work(batch_worker *thief);
+static void worker_main(void *argument);
+static void print_distribution(const char *name, int *values, long count);
+static int batch_usage(const char *program);
+
+move_policy find_policy(const char *name)
+{
+	for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+	{
+		if (strcmp(policies[i].name, name) == 0)
+		{
+			return policies[i].policy;
+		}
+	}
+
+	return NULL;
+}
+
+// any reachable placement
+bool random_policy(game_state *this_game_state, policy_context *context, placement *choice)
+{
+	placement placements[MAX_PLACEMENTS];
+	int count;
+
+	count = find_placements(&(this_game_state->main_matrix),
+		&(this_game_state->active_tetromino), placements);
+	if (count == 0)
+	{
+		return false;
+	}
+
+	*choice = placements[next_random(&(context->random), count)];
+	return true;
+}
+
+// the best placement by the standard evaluator
+bool greedy_policy(game_state *this_game_state, policy_context *context, placement *choice)
+{
+	return best_placement(this_game_state, standard_evaluator, &default_weights, choice);
+}
+
+// the best placement by the feature evaluator, with the feature_weights
+// in the settings, or the default ones
+bool features_policy(game_state *this_game_state, policy_context *context, placement *choice)
+{
+	return best_placement(this_game_state, feature_evaluator,
+		(context->settings != NULL) ? context->settings : &default_feature_weights, choice);
+}
+
+// tries every reachable placement on a copy of the game and keeps the
+// one the evaluator likes best
+static bool best_placement(game_state *this_game_state, board_evaluator evaluator,
+	const void *weights, placement *choice)
+{
+	placement placements[MAX_PLACEMENTS];
+	int count;
+	int best_score = 0;
+	bool found = false;
+
+	count = find_placements(&(this_game_state->main_matrix),
+		&(this_game_state->active_tetromino), placements);
+
+	for (int i = 0; i < count; i++)
+	{
+		game_state trial = *this_game_state;
+		int score;
+
+		if (!play_placement(&trial, placements + i))
+		{
+			continue;
+		}
+
+		exec_step(&trial);
+		score = evaluator(&(trial.main_matrix), trial.num_lines - this_game_state->num_lines, weights);
+
+		if (!found || score > best_score)
+		{
+			best_score = score;
+			*choice = placements[i];
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+// beam search over the active tetromino and the preview
+bool lookahead_policy(game_state *this_game_state, policy_context *context, placement *choice)
+{
+	placement moves[SEARCH_MAX_DEPTH];
+
+	if (context->search == NULL
+		|| find_best_moves(context->search, this_game_state,
+			context->preview, context->preview_length, moves) == 0)
+	{
+		return greedy_policy(this_game_state, context, choice);
+	}
+
+	*choice = moves[0];
+	return true;
+}
+
+void play_game(const batch_config *config, search_context *search, long index, game_result *result)
+{
+	game_state my_game_state;
+	policy_context context;
+	placement choice;
+	piece_bag pieces;
+	int upcoming[BATCH_PREVIEW_LENGTH];
+
+	init(&my_game_state);
+	context.settings = config->policy_settings;
+	if (config->settings_list != NULL)
+	{
+		context.settings = config->settings_list[index / config->games_per_settings];
+		index %= config->games_per_settings;
+	}
+	context.random = seed_random(config->seed, index);
+	context.preview = upcoming;
+	context.preview_length = BATCH_PREVIEW_LENGTH;
+	context.search = search;
+
+	// the pieces get a stream of their own, so that a policy drawing
+	// random numbers doesn't change which pieces come
+	init_bag(&pieces, split_random(&(context.random)), BATCH_PREVIEW_LENGTH);
+
+	result->pieces = 0;
+
+	while (result->pieces < config->max_pieces)
+	{
+		int type = next_piece(&pieces);
+
+		for (int i = 0; i < BATCH_PREVIEW_LENGTH; i++)
+		{
+			upcoming[i] = peek_piece(&pieces, i);
+		}
+
+		if (!spawn_tetromino(&(my_game_state.active_tetromino), type,
+				&(my_game_state.main_matrix))
+			|| !config->policy(&my_game_state, &context, &choice)
+			|| !play_placement(&my_game_state, &choice))
+		{
+			break;
+		}
+
+		result->pieces++;
+		exec_step(&my_game_state);
+	}
+
+	result->score = my_game_state.score;
+	result->num_lines = my_game_state.num_lines;
+}
+
+// Plays config->games games on a pool of threads and returns the wall
+// clock time it took. Each worker starts with an equal slice of the game
+// indices and steals half of someone else's remaining slice when its own
+// runs out, so slow games do not leave cores idle at the end.
+double run_batch(const batch_config *config, game_result *results)
+{
+	batch_worker *workers;
+	int num_workers = config->threads > 0 ? config->threads : count_cpus();
+	double start;
+
+	if (num_workers > config->games)
+	{
+		num_workers = config->games > 0 ? (int)config->games : 1;
+	}
+
+	workers = (batch_worker *)calloc(num_workers, sizeof(batch_worker));
+	if (workers == NULL)
+	{
+		return -1.0;
+	}
+
+	for (int i = 0; i < num_workers; i++)
+	{
+		workers[i].config = config;
+		workers[i].results = results;
+		workers[i].workers = workers;
+		workers[i].num_workers = num_workers;
+		workers[i].index = i;
+		init_lock(&(workers[i].queue.lock));
+		// done here rather than on the worker, so that clearing the
+		// tables happens before the clock starts
+		if (!init_search(&(workers[i].search), &default_search_config,
+				SEARCH_DEFAULT_TABLE_BITS))
+		{
+			free_search(&(workers[i].search));
+		}
+		workers[i].queue.next = config->games * i / num_workers;
+		workers[i].queue.end = config->games * (i + 1) / num_workers;
+	}
+
+	start = seconds_now();
+
+	// worker 0 runs on the calling thread
+	for (int i = 1; i < num_workers; i++)
+	{
+		// if this fails, its games get stolen by the others
+		workers[i].started = start_thread(&(workers[i].thread), worker_main, workers + i);
+	}
+
+	worker_main(workers);
+
+	for (int i = 1; i < num_workers; i++)
+	{
+		if (workers[i].started)
+		{
+			join_thread(&(workers[i].thread));
+		}
+	}
+
+	start = seconds_now() - start;
+
+	for (int i = 0; i < num_workers; i++)
+	{
+		destroy_lock(&(workers[i].queue.lock));
+		free_search(&(workers[i].search));
+	}
+	free(workers);
+
+	return start;
+}
+
+static void worker_main(void *argument)
+{
+	batch_worker *this_worker = (batch_worker *)argument;
+	long game;
+
+	for (;;)
+	{
+		if (!take_work(&(this_worker->queue), &game))
+		{
+			if (!steal_work(this_worker))
+			{
+				break;
+			}
+			continue;
+		}
+
+		play_game(this_worker->config,
+			this_worker->search.table != NULL ? &(this_worker->search) : NULL,
+			game, this_worker->results + game);
+	}
+}
+
+static bool take_work(work_queue *queue, long *game)
+{
+	bool taken = false;
+
+	acquire_lock(&(queue->lock));
+	if (queue->next < queue->end)
+	{
+		*game = queue->next++;
+		taken = true;
+	}
+	release_lock(&(queue->lock));
+
+	return taken;
+}
+
+static bool steal_work(batch_worker *thief)
+{
+	batch_worker *workers = thief->workers;
+	int count = thief->num_workers;
+
+	for (int i = 1; i < count; i++)
+	{
+		work_queue *victim = &(workers[(thief->index + i) % count].queue);
+		long next, end;
+
+		acquire_lock(&(victim->lock));
+		next = victim->next;
+		end = victim->end;
+		if (next < end)
+		{
+			// take the back half, the victim keeps working from the front
+			next += (end - next) / 2;
+			victim->end = next;
+		}
+		release_lock(&(victim->lock));
+
+		if (next < end)
+		{
+			acquire_lock(&(thief->queue.lock));
+			thief->queue.next = next;
+			thief->queue.end = end;
+			release_lock(&(thief->queue.lock));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// feature_count integers in board_feature_kinds order, as --tune
+// writes them
+static bool parse_weights(const char *text, feature_weights *weights)
+{
+	for (int kind = 0; kind < feature_count; kind++)
+	{
+		char *end;
+
+		weights->values[kind] = (int)strtol(text, &end, 10);
+		if (end == text || *end != ((kind < feature_count - 1) ? ',' : '\0'))
+		{
+			return false;
+		}
+		text = end + 1;
+	}
+
+	return true;
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	int left = *(const int *)a;
+	int right = *(const int *)b;
+
+	return (left > right) - (left < right);
+}
+
+static void print_distribution(const char *name, int *values, long count)
+{
+	double sum = 0.0;
+
+	qsort(values, count, sizeof(int), compare_ints);
+	for (long i = 0; i < count; i++)
+	{
+		sum += values[i];
+	}
+
+	printf("%s: mean %.2f min %d p50 %d p90 %d p99 %d max %d\n", name,
+		sum / count, values[0], values[(count - 1) / 2],
+		values[(long)((count - 1) * 0.9)], values[(long)((count - 1) * 0.99)],
+		values[count - 1]);
+}
+
+static int batch_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s --batch <games> [--seed n] [--threads n]"
+		" [--pieces n] [--policy random|greedy|features|lookahead] [--weights w,w,...]\n",
+		program);
+	return 1;
+}
+
+// learntris --batch <games> [--seed n] [--threads n] [--pieces n] [--policy name]
+//   [--weights w,w,...]
+int batch_main(int argc, char *argv[])
+{
+	batch_config config;
+	feature_weights weights;
+	game_result *results;
+	int *values;
+	long pieces = 0;
+	double seconds;
+
+	if (argc < 3 || atol(argv[2]) <= 0)
+	{
+		return batch_usage(argv[0]);
+	}
+
+	config.games = atol(argv[2]);
+	config.seed = 1;
+	config.threads = 0;
+	config.max_pieces = BATCH_DEFAULT_MAX_PIECES;
+	config.policy = greedy_policy;
+	config.policy_settings = NULL;
+	config.settings_list = NULL;
+	config.games_per_settings = 0;
+
+	for (int i = 3; i < argc; i += 2)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (value == NULL)
+		{
+			return batch_usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			config.seed = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			config.threads = atoi(value);
+		}
+		else if (strcmp(argv[i], "--pieces") == 0)
+		{
+			config.max_pieces = atoi(value);
+		}
+		else if (strcmp(argv[i], "--policy") == 0)
+		{
+			config.policy = find_policy(value);
+			if (config.policy == NULL)
+			{
+				fprintf(stderr, "unknown policy %s\n", value);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--weights") == 0)
+		{
+			if (!parse_weights(value, &weights))
+			{
+				fprintf(stderr, "--weights takes %d numbers, separated by commas\n", feature_count);
+				return 1;
+			}
+			config.policy_settings = &weights;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// only the features policy reads weights, the others would ignore them
+	if (config.policy_settings != NULL && config.policy != features_policy)
+	{
+		fprintf(stderr, "--weights needs --policy features\n");
+		return 1;
+	}
+
+	results = (game_result *)malloc(config.games * sizeof(game_result));
+	values = (int *)malloc(config.games * sizeof(int));
+	if (results == NULL || values == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(results);
+		free(values);
+		return 1;
+	}
+
+	seconds = run_batch(&config, results);
+	if (seconds < 0.0)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(results);
+		free(values);
+		return 1;
+	}
+
+	for (long i = 0; i < config.games; i++)
+	{
+		pieces += results[i].pieces;
+	}
+
+	printf("games: %ld\n", config.games);
+	printf("pieces: %ld\n", pieces);
+	printf("seconds: %.3f\n", seconds);
+	printf("games/sec: %.1f\n", config.games / seconds);
+	printf("pieces/sec: %.1f\n", pieces / seconds);
+
+	for (long i = 0; i < config.games; i++)
+	{
+		values[i] = results[i].score;
+	}
+	print_distribution("score", values, config.games);
+
+	for (long i = 0; i < config.games; i++)
+	{
+		values[i] = results[i].num_lines;
+	}
+	print_distribution("lines", values, config.games);
+
+	for (long i = 0; i < config.games; i++)
+	{
+		values[i] = results[i].pieces;
+	}
+	print_distribution("pieces", values, config.games);
+
+	free(results);
+	free(values);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef LEARNTRIS_BATCH_H
+#define LEARNTRIS_BATCH_H
+
+#include "learntris.h"
+#include "search.h"
+#include "randomizer.h"
+
+#define BATCH_DEFAULT_MAX_PIECES 10000
+#define BATCH_PREVIEW_LENGTH BAG_DEFAULT_PREVIEW
+
+typedef struct tag_policy_context
+{
+	const void *settings;	// shared by every game, read only
+	random_state random;	// private to the game being played
+	const int *preview;		// the tetrominoes coming after the active one
+	int preview_length;
+	search_context *search;	// private to the worker thread
+} policy_context;
+
+// A move policy looks at the game with a freshly spawned active
+// tetromino and picks where it should go.
+typedef bool (*move_policy)(game_state *this_game_state, policy_context *context, placement *choice);
+
+typedef struct tag_batch_config
+{
+	long games;
+	unsigned long seed;
+	int threads;			// 0 means one per cpu
+	int max_pieces;			// per game, so that good policies terminate
+	move_policy policy;
+	const void *policy_settings;
+	// When not NULL, the games come in groups of games_per_settings,
+	// group n played with settings_list[n] instead of policy_settings.
+	// Every group is dealt the same pieces, so the settings are compared
+	// on the same games.
+	const void *const *settings_list;
+	long games_per_settings;
+} batch_config;
+
+typedef struct tag_game_result
+{
+	int score;
+	int num_lines;
+	int pieces;
+} game_result;
+
+move_policy find_policy(const char *name);
+bool random_policy(game_state *this_game_state, policy_context *context, placement *choice);
+bool greedy_policy(game_state *this_game_state, policy_context *context, placement *choice);
+bool features_policy(game_state *this_game_state, policy_context *context, placement *choice);
+bool lookahead_policy(game_state *this_game_state, policy_context *context, placement *choice);
+void play_game(const batch_config *config, search_context *search, long index, game_result *result);
+double run_batch(const batch_config *config, game_result *results);
+int batch_main(int argc, char *argv[]);
+
+#endif
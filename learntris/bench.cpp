@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "batch.h"
+#include "frontend.h"
+#include "search.h"
+#include "evaluator.h"
+#include "platform.h"
+
+static const char *corpus_names[bench_corpora_count] =
+{
+	"empty", "half", "ragged", "near_top"
+};
+
+static void fill_columns(matrix *this_matrix, random_state *random, int lowest, int highest);
+static void spawn_somewhere(game_state *this_game_state, random_state *random);
+static int bench_copy(game_state *this_game_state);
+static int bench_collision_down(game_state *this_game_state);
+static int bench_collision_left(game_state *this_game_state);
+static int bench_collision_right(game_state *this_game_state);
+static int bench_nudge_down(game_state *this_game_state);
+static int bench_nudge_left(game_state *this_game_state);
+static int bench_nudge_right(game_state *this_game_state);
+static int bench_rotate_right(game_state *this_game_state);
+static int bench_drop(game_state *this_game_state);
+static int bench_step(game_state *this_game_state);
+static int bench_insert(game_state *this_game_state);
+static int bench_format(game_state *this_game_state);
+static int bench_placements(game_state *this_game_state);
+static int bench_standard_evaluator(game_state *this_game_state);
+static int bench_features(game_state *this_game_state);
+static int compare_doubles(const void *a, const void *b);
+static void report(const char *name, const char *corpus, long ops, double seconds,
+	double *sample_ns, int samples);
+static int make_script(char *script, random_state *random);
+static int bench_usage(const char *program);
+
+static const bench_case bench_cases[] =
+{
+	{ "copy_state", bench_copy },
+	{ "check_collision_down", bench_collision_down },
+	{ "check_collision_left", bench_collision_left },
+	{ "check_collision_right", bench_collision_right },
+	{ "nudge_down", bench_nudge_down },
+	{ "nudge_left", bench_nudge_left },
+	{ "nudge_right", bench_nudge_right },
+	{ "rotate_right", bench_rotate_right },
+	{ "drop_tetromino", bench_drop },
+	{ "exec_step", bench_step },
+	{ "insert_tetromino", bench_insert },
+	{ "format_matrix", bench_format },
+	{ "find_placements", bench_placements },
+	{ "standard_evaluator", bench_standard_evaluator },
+	{ "compute_features", bench_features }
+};
+
+// every op adds into this so the compiler has to keep the calls
+static volatile int bench_sink;
+
+// stacks between lowest and highest filled rows per column, with
+// every eighth square under the surface left as a hole
+static void fill_columns(matrix *this_matrix, random_state *random, int lowest, int highest)
+{
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		int height = lowest + next_random(random, highest - lowest + 1);
+
+		for (int row = MATRIX_DEPTH - height; row < MATRIX_DEPTH; row++)
+		{
+			if (row == MATRIX_DEPTH - height || next_random(random, 8) != 0)
+			{
+				this_matrix->rows[row] |= 1 << col;
+				this_matrix->squares[MATRIX_WIDTH * row + col] = tetromino_mask_table[col % 7].color;
+			}
+		}
+	}
+}
+
+// a random tetromino at its spawn point, moved sideways a bit
+static void spawn_somewhere(game_state *this_game_state, random_state *random)
+{
+	int shift = (int)next_random(random, 9) - 4;
+
+	spawn_tetromino(&(this_game_state->active_tetromino), next_random(random, tetromino_Z + 1),
+		&(this_game_state->main_matrix));
+
+	for (; shift < 0; shift++)
+	{
+		nudge_left(&(this_game_state->active_tetromino), &(this_game_state->main_matrix));
+	}
+	for (; shift > 0; shift--)
+	{
+		nudge_right(&(this_game_state->active_tetromino), &(this_game_state->main_matrix));
+	}
+}
+
+// The same seed always gives the same boards:
+//   empty     nothing in the matrix
+//   half      the bottom half filled, one hole per row, the odd full row
+//   ragged    columns anywhere from 0 to 14 high, with holes
+//   near_top  columns 16 to 19 high, three rows short of topping out
+void make_corpus(game_state *boards, int count, int corpus, unsigned long seed)
+{
+	random_state random = seed_random(seed, corpus);
+
+	for (int i = 0; i < count; i++)
+	{
+		matrix *this_matrix = &(boards[i].main_matrix);
+
+		init(boards + i);
+
+		switch (corpus)
+		{
+		case corpus_half:
+			for (int row = MATRIX_DEPTH / 2; row < MATRIX_DEPTH; row++)
+			{
+				int hole = (next_random(&random, 8) == 0) ? -1 : (int)next_random(&random, MATRIX_WIDTH);
+
+				for (int col = 0; col < MATRIX_WIDTH; col++)
+				{
+					if (col != hole)
+					{
+						this_matrix->rows[row] |= 1 << col;
+						this_matrix->squares[MATRIX_WIDTH * row + col] = tetromino_mask_table[row % 7].color;
+					}
+				}
+			}
+			break;
+		case corpus_ragged:
+			fill_columns(this_matrix, &random, 0, 14);
+			break;
+		case corpus_near_top:
+			fill_columns(this_matrix, &random, 16, 19);
+			break;
+		default:
+			break;
+		}
+
+		sync_matrix(this_matrix);
+		spawn_somewhere(boards + i, &random);
+	}
+}
+
+// what every op that changes the board pays for working on a copy;
+// the copy is static so it can't be left out
+static int bench_copy(game_state *this_game_state)
+{
+	static game_state copy;
+
+	copy = *this_game_state;
+	return copy.score;
+}
+
+static int bench_collision_down(game_state *this_game_state)
+{
+	return check_collision_down(&(this_game_state->active_tetromino), &(this_game_state->main_matrix));
+}
+
+static int bench_collision_left(game_state *this_game_state)
+{
+	return check_collision_left(&(this_game_state->active_tetromino), &(this_game_state->main_matrix));
+}
+
+static int bench_collision_right(game_state *this_game_state)
+{
+	return check_collision_right(&(this_game_state->active_tetromino), &(this_game_state->main_matrix));
+}
+
+static int bench_nudge_down(game_state *this_game_state)
+{
+	tetromino piece = this_game_state->active_tetromino;
+
+	return nudge_down(&piece, &(this_game_state->main_matrix)) + piece.location.top;
+}
+
+static int bench_nudge_left(game_state *this_game_state)
+{
+	tetromino piece = this_game_state->active_tetromino;
+
+	return nudge_left(&piece, &(this_game_state->main_matrix)) + piece.location.left;
+}
+
+static int bench_nudge_right(game_state *this_game_state)
+{
+	tetromino piece = this_game_state->active_tetromino;
+
+	return nudge_right(&piece, &(this_game_state->main_matrix)) + piece.location.left;
+}
+
+static int bench_rotate_right(game_state *this_game_state)
+{
+	tetromino piece = this_game_state->active_tetromino;
+
+	return rotate_right(&piece, &(this_game_state->main_matrix)) + piece.location.left;
+}
+
+static int bench_drop(game_state *this_game_state)
+{
+	game_state copy = *this_game_state;
+
+	return drop_tetromino(&copy) + copy.main_matrix.rows[MATRIX_DEPTH - 1];
+}
+
+static int bench_step(game_state *this_game_state)
+{
+	game_state copy = *this_game_state;
+
+	exec_step(&copy);
+	return copy.num_lines;
+}
+
+static int bench_insert(game_state *this_game_state)
+{
+	matrix copy = this_game_state->main_matrix;
+
+	insert_tetromino(&copy, &(this_game_state->active_tetromino));
+	return copy.rows[MATRIX_DEPTH - 1];
+}
+
+// print_matrix without its one fwrite
+static int bench_format(game_state *this_game_state)
+{
+	char frame[FRAME_SIZE];
+
+	format_matrix(&(this_game_state->main_matrix), frame);
+	return frame[FRAME_SIZE - 2];
+}
+
+static int bench_placements(game_state *this_game_state)
+{
+	placement placements[MAX_PLACEMENTS];
+
+	return find_placements(&(this_game_state->main_matrix), &(this_game_state->active_tetromino),
+		placements);
+}
+
+static int bench_standard_evaluator(game_state *this_game_state)
+{
+	return standard_evaluator(&(this_game_state->main_matrix), 0, &default_weights);
+}
+
+static int bench_features(game_state *this_game_state)
+{
+	return feature_evaluator(&(this_game_state->main_matrix), 0, &default_feature_weights);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+// one csv line; the percentiles are of the per-sample averages
+static void report(const char *name, const char *corpus, long ops, double seconds,
+	double *sample_ns, int samples)
+{
+	qsort(sample_ns, samples, sizeof(double), compare_doubles);
+	printf("%s,%s,%ld,%.2f,%.0f,%.2f,%.2f,%.2f,%.2f\n", name, corpus, ops,
+		seconds * 1e9 / ops, ops / seconds, sample_ns[0], sample_ns[(samples - 1) / 2],
+		sample_ns[(long)((samples - 1) * 0.9)], sample_ns[(long)((samples - 1) * 0.99)]);
+}
+
+// a game the way a player types it: clear the matrix, then for every
+// piece spawn, turn, slide, drop and step
+static int make_script(char *script, random_state *random)
+{
+	const char spawns[] = "IJLOSTZ";
+	char *out = script;
+
+	*out++ = 'c';
+	for (int piece = 0; piece < BENCH_GAME_PIECES; piece++)
+	{
+		int turns = next_random(random, 4);
+		int shift = (int)next_random(random, 11) - 5;
+
+		*out++ = spawns[next_random(random, 7)];
+		for (; turns > 0; turns--)
+		{
+			*out++ = ')';
+		}
+		for (; shift < 0; shift++)
+		{
+			*out++ = '<';
+		}
+		for (; shift > 0; shift--)
+		{
+			*out++ = '>';
+		}
+		*out++ = 'V';
+		*out++ = 's';
+	}
+
+	return (int)(out - script);
+}
+
+static int bench_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s --bench [--seed n] [--samples n]\n", program);
+	return 1;
+}
+
+// learntris --bench [--seed n] [--samples n]
+// Times every engine primitive against every corpus, then whole
+// scripted games through game_loop, and prints one csv line each:
+// ns_per_op and ops_per_sec over the whole run, then the fastest,
+// median, p90 and p99 of the timed samples.
+int bench_main(int argc, char *argv[])
+{
+	unsigned long seed = 1;
+	int samples = BENCH_DEFAULT_SAMPLES;
+	game_state boards[BENCH_BOARDS];
+	double *sample_ns;
+	char *script;
+	random_state random;
+
+	for (int i = 2; i < argc; i += 2)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (value == NULL)
+		{
+			return bench_usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			seed = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--samples") == 0)
+		{
+			samples = atoi(value);
+		}
+		else
+		{
+			return bench_usage(argv[0]);
+		}
+	}
+
+	if (samples <= 0)
+	{
+		return bench_usage(argv[0]);
+	}
+
+	// each piece takes at most 11 commands
+	sample_ns = (double *)malloc(samples * sizeof(double));
+	script = (char *)malloc(BENCH_GAME_PIECES * 11 + 2);
+	if (sample_ns == NULL || script == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(sample_ns);
+		free(script);
+		return 1;
+	}
+
+	printf("benchmark,corpus,ops,ns_per_op,ops_per_sec,min_ns,p50_ns,p90_ns,p99_ns\n");
+
+	for (int corpus = 0; corpus < bench_corpora_count; corpus++)
+	{
+		make_corpus(boards, BENCH_BOARDS, corpus, seed);
+
+		for (size_t k = 0; k < sizeof(bench_cases) / sizeof(bench_cases[0]); k++)
+		{
+			bench_operation operation = bench_cases[k].operation;
+			double total = 0.0;
+			int sum = 0;
+
+			for (int s = 0; s < samples; s++)
+			{
+				double start = seconds_now();
+				double seconds;
+
+				for (int i = 0; i < BENCH_SAMPLE_OPS; i++)
+				{
+					sum += operation(boards + i % BENCH_BOARDS);
+				}
+
+				seconds = seconds_now() - start;
+				sample_ns[s] = seconds * 1e9 / BENCH_SAMPLE_OPS;
+				total += seconds;
+			}
+
+			bench_sink += sum;
+			report(bench_cases[k].name, corpus_names[corpus],
+				(long)samples * BENCH_SAMPLE_OPS, total, sample_ns, samples);
+		}
+	}
+
+	// whole games, a sample per game, measured per command typed; the
+	// scripts never print anything
+	random = seed_random(seed, bench_corpora_count);
+	{
+		double total = 0.0;
+		long commands = 0;
+
+		for (int s = 0; s < samples; s++)
+		{
+			int length = make_script(script, &random);
+			command_source source;
+			output_sink out;
+			double start, seconds;
+
+			init_buffer_source(&source, script, length);
+			init_file_output(&out, stdout);
+			start = seconds_now();
+			game_loop(&source, &out);
+			seconds = seconds_now() - start;
+
+			sample_ns[s] = seconds * 1e9 / length;
+			total += seconds;
+			commands += length;
+		}
+
+		report("scripted_game", "script", commands, total, sample_ns, samples);
+	}
+
+	free(sample_ns);
+	free(script);
+	return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef LEARNTRIS_BENCH_H
+#define LEARNTRIS_BENCH_H
+
+#include "learntris.h"
+
+#define BENCH_BOARDS 64			// boards in every corpus
+#define BENCH_DEFAULT_SAMPLES 201
+#define BENCH_SAMPLE_OPS 512	// calls per timed sample, to hide the clock
+#define BENCH_GAME_PIECES 100	// pieces in every scripted game
+
+// the boards every primitive is timed against
+enum bench_corpora
+{
+	corpus_empty,
+	corpus_half,
+	corpus_ragged,
+	corpus_near_top,
+	bench_corpora_count
+};
+
+// One primitive under test. Returns something derived from the result
+// so the call can't be optimized away; it must leave the board as it
+// found it.
+typedef int (*bench_operation)(game_state *this_game_state);
+
+typedef struct tag_bench_case
+{
+	const char *name;
+	bench_operation operation;
+} bench_case;
+
+void make_corpus(game_state *boards, int count, int corpus, unsigned long seed);
+int bench_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board_batch.h"
+#include "batch.h"
+#include "platform.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define STEP_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define STEP_AVX2 1
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#if _MSC_VER >= 1800
+#include <immintrin.h>
+#define STEP_AVX2 1
+#endif
+#endif
+#endif
+
+#define STEP_SCORE 100
+
+static row_bitfield *board_row(board_batch *this_batch, int board, int row);
+static void step_scalar(board_batch *this_batch);
+#ifdef STEP_SSE2
+static bool cpu_has_sse2();
+static void step_sse2(board_batch *this_batch);
+#endif
+#ifdef STEP_AVX2
+static bool cpu_has_avx2();
+static void step_avx2(board_batch *this_batch);
+#endif
+
+bool init_board_batch(board_batch *this_batch, int count)
+{
+	int capacity = (count + BOARD_BATCH_LANES - 1) / BOARD_BATCH_LANES * BOARD_BATCH_LANES;
+
+	this_batch->count = count;
+	this_batch->capacity = capacity;
+	this_batch->rows = (row_bitfield *)calloc((size_t)capacity * MATRIX_DEPTH, sizeof(row_bitfield));
+	this_batch->scores = (int *)calloc(capacity, sizeof(int));
+	this_batch->num_lines = (int *)calloc(capacity, sizeof(int));
+
+	if (this_batch->rows == NULL || this_batch->scores == NULL || this_batch->num_lines == NULL)
+	{
+		free_board_batch(this_batch);
+		return false;
+	}
+
+	select_step_kernel(this_batch, NULL);
+	return true;
+}
+
+void free_board_batch(board_batch *this_batch)
+{
+	free(this_batch->rows);
+	free(this_batch->scores);
+	free(this_batch->num_lines);
+	this_batch->rows = NULL;
+	this_batch->scores = NULL;
+	this_batch->num_lines = NULL;
+	this_batch->count = 0;
+	this_batch->capacity = 0;
+}
+
+// NULL picks the widest kernel this cpu runs; otherwise "avx2", "sse2"
+// or "scalar". Returns false if the named kernel is not available.
+bool select_step_kernel(board_batch *this_batch, const char *name)
+{
+#ifdef STEP_AVX2
+	if ((name == NULL || strcmp(name, "avx2") == 0) && cpu_has_avx2())
+	{
+		this_batch->kernel = step_avx2;
+		this_batch->kernel_name = "avx2";
+		return true;
+	}
+#endif
+#ifdef STEP_SSE2
+	if ((name == NULL || strcmp(name, "sse2") == 0) && cpu_has_sse2())
+	{
+		this_batch->kernel = step_sse2;
+		this_batch->kernel_name = "sse2";
+		return true;
+	}
+#endif
+	if (name == NULL || strcmp(name, "scalar") == 0)
+	{
+		this_batch->kernel = step_scalar;
+		this_batch->kernel_name = "scalar";
+		return true;
+	}
+
+	return false;
+}
+
+static row_bitfield *board_row(board_batch *this_batch, int board, int row)
+{
+	return this_batch->rows + (board / BOARD_BATCH_LANES) * BOARD_BLOCK_SIZE
+		+ row * BOARD_BATCH_LANES + board % BOARD_BATCH_LANES;
+}
+
+void load_board(board_batch *this_batch, int board, game_state *this_game_state)
+{
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		*board_row(this_batch, board, row) = this_game_state->main_matrix.rows[row];
+	}
+
+	this_batch->scores[board] = this_game_state->score;
+	this_batch->num_lines[board] = this_game_state->num_lines;
+}
+
+// The batch only holds occupancy, so the colors are brought along by
+// collapsing the rows of this_game_state that were full, which is what
+// the step did; this_game_state has to hold the board that was loaded.
+void store_board(board_batch *this_batch, int board, game_state *this_game_state)
+{
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	unsigned int full_rows = 0;
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		if (row_full(this_matrix, row))
+		{
+			full_rows |= 1u << row;
+		}
+	}
+	if (full_rows != 0)
+	{
+		collapse_rows(this_matrix, full_rows);
+	}
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		this_matrix->rows[row] = *board_row(this_batch, board, row);
+	}
+	sync_matrix(this_matrix);
+
+	this_game_state->score = this_batch->scores[board];
+	this_game_state->num_lines = this_batch->num_lines[board];
+}
+
+// exec_step on every board of the batch
+void step_boards(board_batch *this_batch)
+{
+	this_batch->kernel(this_batch);
+}
+
+static void step_scalar(board_batch *this_batch)
+{
+	for (int base = 0; base < this_batch->count; base += BOARD_BATCH_LANES)
+	{
+		row_bitfield *rows = board_row(this_batch, base, 0);
+
+		for (int lane = 0; lane < BOARD_BATCH_LANES; lane++)
+		{
+			int kept = MATRIX_DEPTH;
+
+			// copy the rows that stay down over the full ones, bottom up
+			for (int row = MATRIX_DEPTH - 1; row >= 0; row--)
+			{
+				row_bitfield bits = rows[row * BOARD_BATCH_LANES + lane];
+
+				if (bits == FULL_ROW)
+				{
+					this_batch->num_lines[base + lane]++;
+					this_batch->scores[base + lane] += STEP_SCORE;
+				}
+				else
+				{
+					rows[--kept * BOARD_BATCH_LANES + lane] = bits;
+				}
+			}
+
+			while (kept > 0)
+			{
+				rows[--kept * BOARD_BATCH_LANES + lane] = 0;
+			}
+		}
+	}
+}
+
+#ifdef STEP_SSE2
+
+static bool cpu_has_sse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true;
+#elif defined(__GNUC__)
+	return __builtin_cpu_supports("sse2") != 0;
+#else
+	int info[4];
+
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#endif
+}
+
+// 8 boards per vector: a full row compares to all ones, and the all-ones
+// lane doubles as -1 in the per-board line count. Rows are handled top
+// down; where a row is full, the lanes it is full in have every row
+// above it moved down one, so each board falls by its own amount.
+TARGET_SSE2 static void step_sse2(board_batch *this_batch)
+{
+	const __m128i full = _mm_set1_epi16((short)FULL_ROW);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i score = _mm_set1_epi16(STEP_SCORE);
+
+	for (int base = 0; base < this_batch->count; base += 8)
+	{
+		row_bitfield *rows = board_row(this_batch, base, 0);
+		__m128i cleared = zero;
+		__m128i *lines = (__m128i *)(this_batch->num_lines + base);
+		__m128i *scores = (__m128i *)(this_batch->scores + base);
+		__m128i points;
+
+		for (int row = 0; row < MATRIX_DEPTH; row++)
+		{
+			__m128i *bits = (__m128i *)(rows + row * BOARD_BATCH_LANES);
+			__m128i is_full = _mm_cmpeq_epi16(_mm_loadu_si128(bits), full);
+			__m128i above;
+
+			if (_mm_movemask_epi8(is_full) == 0)
+			{
+				continue;
+			}
+
+			for (int fall = row; fall > 0; fall--)
+			{
+				bits = (__m128i *)(rows + fall * BOARD_BATCH_LANES);
+				above = _mm_loadu_si128((__m128i *)(rows + (fall - 1) * BOARD_BATCH_LANES));
+				_mm_storeu_si128(bits, _mm_or_si128(_mm_and_si128(is_full, above),
+					_mm_andnot_si128(is_full, _mm_loadu_si128(bits))));
+			}
+			bits = (__m128i *)rows;
+			_mm_storeu_si128(bits, _mm_andnot_si128(is_full, _mm_loadu_si128(bits)));
+			cleared = _mm_sub_epi16(cleared, is_full);
+		}
+
+		points = _mm_mullo_epi16(cleared, score);
+		_mm_storeu_si128(lines, _mm_add_epi32(_mm_loadu_si128(lines),
+			_mm_unpacklo_epi16(cleared, zero)));
+		_mm_storeu_si128(lines + 1, _mm_add_epi32(_mm_loadu_si128(lines + 1),
+			_mm_unpackhi_epi16(cleared, zero)));
+		_mm_storeu_si128(scores, _mm_add_epi32(_mm_loadu_si128(scores),
+			_mm_unpacklo_epi16(points, zero)));
+		_mm_storeu_si128(scores + 1, _mm_add_epi32(_mm_loadu_si128(scores + 1),
+			_mm_unpackhi_epi16(points, zero)));
+	}
+}
+
+#endif
+
+#ifdef STEP_AVX2
+
+static bool cpu_has_avx2()
+{
+#if defined(__GNUC__)
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	int info[4];
+
+	__cpuid(info, 1);
+	// the os has to save the ymm registers too
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// same as step_sse2, a whole block of 16 boards per vector
+TARGET_AVX2 static void step_avx2(board_batch *this_batch)
+{
+	const __m256i full = _mm256_set1_epi16((short)FULL_ROW);
+	const __m256i score = _mm256_set1_epi16(STEP_SCORE);
+
+	for (int base = 0; base < this_batch->count; base += BOARD_BATCH_LANES)
+	{
+		row_bitfield *rows = board_row(this_batch, base, 0);
+		__m256i cleared = _mm256_setzero_si256();
+		__m256i *lines = (__m256i *)(this_batch->num_lines + base);
+		__m256i *scores = (__m256i *)(this_batch->scores + base);
+		__m256i points;
+
+		for (int row = 0; row < MATRIX_DEPTH; row++)
+		{
+			__m256i *bits = (__m256i *)(rows + row * BOARD_BATCH_LANES);
+			__m256i is_full = _mm256_cmpeq_epi16(_mm256_loadu_si256(bits), full);
+			__m256i above;
+
+			if (_mm256_testz_si256(is_full, is_full))
+			{
+				continue;
+			}
+
+			for (int fall = row; fall > 0; fall--)
+			{
+				bits = (__m256i *)(rows + fall * BOARD_BATCH_LANES);
+				above = _mm256_loadu_si256((__m256i *)(rows + (fall - 1) * BOARD_BATCH_LANES));
+				_mm256_storeu_si256(bits, _mm256_blendv_epi8(_mm256_loadu_si256(bits),
+					above, is_full));
+			}
+			bits = (__m256i *)rows;
+			_mm256_storeu_si256(bits, _mm256_andnot_si256(is_full, _mm256_loadu_si256(bits)));
+			cleared = _mm256_sub_epi16(cleared, is_full);
+		}
+
+		points = _mm256_mullo_epi16(cleared, score);
+		_mm256_storeu_si256(lines, _mm256_add_epi32(_mm256_loadu_si256(lines),
+			_mm256_cvtepu16_epi32(_mm256_castsi256_si128(cleared))));
+		_mm256_storeu_si256(lines + 1, _mm256_add_epi32(_mm256_loadu_si256(lines + 1),
+			_mm256_cvtepu16_epi32(_mm256_extracti128_si256(cleared, 1))));
+		_mm256_storeu_si256(scores, _mm256_add_epi32(_mm256_loadu_si256(scores),
+			_mm256_cvtepu16_epi32(_mm256_castsi256_si128(points))));
+		_mm256_storeu_si256(scores + 1, _mm256_add_epi32(_mm256_loadu_si256(scores + 1),
+			_mm256_cvtepu16_epi32(_mm256_extracti128_si256(points, 1))));
+	}
+}
+
+#endif
+
+// learntris --step-bench [boards] [iterations]
+// Times exec_step one game at a time against every step kernel, on the
+// same random boards, and checks that the kernels agree with exec_step.
+int step_bench_main(int argc, char *argv[])
+{
+	const char *kernels[] = { "scalar", "sse2", "avx2" };
+	int count = (argc > 2) ? atoi(argv[2]) : 4096;
+	int iterations = (argc > 3) ? atoi(argv[3]) : 1000;
+	game_state *originals, *games;
+	board_batch boards;
+	random_state random = seed_random(1, 0);
+	double start, seconds;
+
+	if (count <= 0 || iterations <= 0)
+	{
+		fprintf(stderr, "usage: %s --step-bench [boards] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	originals = (game_state *)malloc(count * sizeof(game_state));
+	games = (game_state *)malloc(count * sizeof(game_state));
+	if (originals == NULL || games == NULL || !init_board_batch(&boards, count))
+	{
+		fprintf(stderr, "out of memory\n");
+		free(originals);
+		free(games);
+		return 1;
+	}
+
+	// half-filled boards with the odd full row
+	for (int i = 0; i < count; i++)
+	{
+		init(originals + i);
+		for (int row = MATRIX_DEPTH / 2; row < MATRIX_DEPTH; row++)
+		{
+			originals[i].main_matrix.rows[row] = (next_random(&random, 8) == 0)
+				? FULL_ROW : (row_bitfield)next_random(&random, FULL_ROW + 1);
+		}
+		sync_matrix(&(originals[i].main_matrix));
+		games[i] = originals[i];
+	}
+
+	printf("boards: %d\n", count);
+	printf("iterations: %d\n", iterations);
+
+	start = seconds_now();
+	for (int n = 0; n < iterations; n++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			// the kernels check every row, make exec_step do the same
+			games[i].main_matrix.touched_rows = ALL_ROWS;
+			exec_step(games + i);
+		}
+	}
+	seconds = seconds_now() - start;
+	printf("exec_step: %.2f ns/board\n", seconds * 1e9 / ((double)count * iterations));
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		bool agrees = true;
+
+		if (!select_step_kernel(&boards, kernels[k]))
+		{
+			printf("%s: not available\n", kernels[k]);
+			continue;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			load_board(&boards, i, originals + i);
+		}
+
+		start = seconds_now();
+		for (int n = 0; n < iterations; n++)
+		{
+			step_boards(&boards);
+		}
+		seconds = seconds_now() - start;
+
+		for (int i = 0; i < count; i++)
+		{
+			game_state result = originals[i];
+
+			store_board(&boards, i, &result);
+			agrees = agrees && memcmp(&(result.main_matrix), &(games[i].main_matrix),
+					sizeof(matrix)) == 0
+				&& result.score == games[i].score
+				&& result.num_lines == games[i].num_lines;
+		}
+
+		printf("%s: %.2f ns/board%s\n", kernels[k],
+			seconds * 1e9 / ((double)count * iterations), agrees ? "" : " MISMATCH");
+	}
+
+	free_board_batch(&boards);
+	free(originals);
+	free(games);
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef LEARNTRIS_BOARD_BATCH_H
+#define LEARNTRIS_BOARD_BATCH_H
+
+#include "learntris.h"
+
+// boards are stored in blocks of this many, row by row, so that one
+// row of a whole block is a single 256-bit vector
+#define BOARD_BATCH_LANES 16
+#define BOARD_BLOCK_SIZE (MATRIX_DEPTH * BOARD_BATCH_LANES)
+
+struct tag_board_batch;
+typedef void (*step_kernel)(struct tag_board_batch *this_batch);
+
+// Many boards, structure-of-arrays, for stepping whole populations of
+// games together. Only the occupancy is kept; use store_board to get a
+// board back into a game_state.
+typedef struct tag_board_batch
+{
+	int count;
+	int capacity;			// count rounded up to BOARD_BATCH_LANES
+	row_bitfield *rows;		// [block][row][lane]
+	int *scores;
+	int *num_lines;
+	step_kernel kernel;
+	const char *kernel_name;
+} board_batch;
+
+bool init_board_batch(board_batch *this_batch, int count);
+void free_board_batch(board_batch *this_batch);
+bool select_step_kernel(board_batch *this_batch, const char *name);
+void load_board(board_batch *this_batch, int board, game_state *this_game_state);
+void store_board(board_batch *this_batch, int board, game_state *this_game_state);
+void step_boards(board_batch *this_batch);
+int step_bench_main(int argc, char *argv[]);
+
+#endif
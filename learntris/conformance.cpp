@@ -0,0 +1,554 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "conformance.h"
+#include "frontend.h"
+#include "platform.h"
+
+#define LINE_LIMIT 4096
+
+typedef struct tag_conformance_result
+{
+	bool passed;
+	output_sink actual;
+} conformance_result;
+
+typedef struct tag_conformance_run
+{
+	const conformance_corpus *corpus;
+	conformance_result *results;
+	int next;
+	lock_handle lock;
+} conformance_run;
+
+static int add_text(conformance_corpus *corpus, const char *text, size_t length);
+static const char *strip(const char *begin, const char *end, const char **stripped_end);
+static void compile_test(conformance_corpus *corpus, const char *name, int name_length,
+	const char **lines, const char **line_ends, int count);
+static int split_lines(char *text, size_t size, char **lines);
+static bool run_test(const conformance_corpus *corpus, int index, output_sink *actual);
+static void conformance_worker(void *argument);
+static void print_diff(char **actual, int actual_count, char **expected, int expected_count);
+static void report_failure(const conformance_corpus *corpus, int index, output_sink *actual);
+
+// appends a NUL terminated copy, returns its offset; -1 if out of memory
+static int add_text(conformance_corpus *corpus, const char *text, size_t length)
+{
+	int offset = (int)corpus->size;
+
+	if (corpus->size + length + 1 > corpus->capacity)
+	{
+		size_t capacity = (corpus->capacity == 0) ? 65536 : corpus->capacity * 2;
+		char *data;
+
+		while (capacity < corpus->size + length + 1)
+		{
+			capacity *= 2;
+		}
+
+		data = (char *)realloc(corpus->text, capacity);
+		if (data == NULL)
+		{
+			return -1;
+		}
+		corpus->text = data;
+		corpus->capacity = capacity;
+	}
+
+	if (length > 0)
+	{
+		memcpy(corpus->text + corpus->size, text, length);
+	}
+	corpus->text[corpus->size + length] = '\0';
+	corpus->size += length + 1;
+	return offset;
+}
+
+// the same as python's str.strip()
+static const char *strip(const char *begin, const char *end, const char **stripped_end)
+{
+	while (begin < end && isspace((unsigned char)*begin))
+	{
+		begin++;
+	}
+	while (end > begin && isspace((unsigned char)end[-1]))
+	{
+		end--;
+	}
+
+	*stripped_end = end;
+	return begin;
+}
+
+// parse_test from testris.py, over the lines between #+begin_src and
+// #+end_src
+static void compile_test(conformance_corpus *corpus, const char *name, int name_length,
+	const char **lines, const char **line_ends, int count)
+{
+	conformance_test test;
+	output_sink input, doc, expected;
+	const char *title = "";
+	const char *title_end = title;
+	bool ok;
+
+	// trailing blank lines are not expected output
+	while (count > 0)
+	{
+		const char *end;
+
+		if (strip(lines[count - 1], line_ends[count - 1], &end) != end)
+		{
+			break;
+		}
+		count--;
+	}
+
+	init_memory_output(&input);
+	init_memory_output(&doc);
+	init_memory_output(&expected);
+	test.expected_lines = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		const char *begin = lines[i];
+		const char *end = line_ends[i];
+		const char *comment = (const char *)memchr(begin, '#', end - begin);
+
+		if (comment == begin)
+		{
+			continue;
+		}
+		if (comment != NULL)
+		{
+			end = comment;
+		}
+
+		begin = strip(begin, end, &end);
+
+		if (begin < end && *begin == '=')
+		{
+			title = (end - begin > 2) ? begin + 2 : end;
+			title_end = end;
+		}
+		else if (begin < end && *begin == ':')
+		{
+			if (doc.size > 0)
+			{
+				write_output(&doc, "\n", 1);
+			}
+			write_output(&doc, begin, end - begin);
+		}
+		else if (begin < end && *begin == '>')
+		{
+			for (begin++; begin < end && isspace((unsigned char)*begin); begin++)
+				;
+			write_output(&input, begin, end - begin);
+			write_output(&input, "\n", 1);
+		}
+		else
+		{
+			if (test.expected_lines++ > 0)
+			{
+				write_output(&expected, "\n", 1);
+			}
+			write_output(&expected, begin, end - begin);
+		}
+	}
+
+	test.name = add_text(corpus, name, name_length);
+	test.title = add_text(corpus, title, title_end - title);
+	test.doc = add_text(corpus, doc.data, doc.size);
+	test.input = add_text(corpus, input.data, input.size);
+	test.input_length = (int)input.size;
+	test.expected = add_text(corpus, expected.data, expected.size);
+	ok = test.name >= 0 && test.title >= 0 && test.doc >= 0
+		&& test.input >= 0 && test.expected >= 0;
+
+	free_output(&input);
+	free_output(&doc);
+	free_output(&expected);
+
+	if (!ok)
+	{
+		return;
+	}
+
+	if (corpus->count == corpus->capacity_tests)
+	{
+		int capacity = (corpus->capacity_tests == 0) ? 64 : corpus->capacity_tests * 2;
+		conformance_test *tests = (conformance_test *)realloc(corpus->tests,
+			capacity * sizeof(conformance_test));
+
+		if (tests == NULL)
+		{
+			return;
+		}
+		corpus->tests = tests;
+		corpus->capacity_tests = capacity;
+	}
+
+	corpus->tests[corpus->count++] = test;
+}
+
+// The state machine from extract.py: a "#+name:" line names the next
+// test, which is everything from "#+begin_src" to "#+end_src".
+bool compile_testplan(const char *path, conformance_corpus *corpus)
+{
+	mapped_file plan;
+	const char *name = "";
+	const char *name_end;
+	int name_length = 0;
+	const char **lines = (const char **)malloc(LINE_LIMIT * sizeof(const char *));
+	const char **line_ends = (const char **)malloc(LINE_LIMIT * sizeof(const char *));
+	int count = 0;
+	bool in_test = false;
+	const char *line, *end;
+
+	memset(corpus, 0, sizeof(conformance_corpus));
+
+	if (lines == NULL || line_ends == NULL || !map_file(path, &plan))
+	{
+		free(lines);
+		free(line_ends);
+		return false;
+	}
+
+	end = plan.data + plan.size;
+	for (line = plan.data; line < end; )
+	{
+		const char *newline = (const char *)memchr(line, '\n', end - line);
+		const char *line_end = (newline != NULL) ? newline : end;
+
+		if (!in_test && line_end - line >= 7 && strncmp(line, "#+name:", 7) == 0)
+		{
+			const char *colon = (const char *)memchr(line + 7, ':', line_end - line - 7);
+
+			name = strip(line + 7, (colon != NULL) ? colon : line_end, &name_end);
+			name_length = (int)(name_end - name);
+		}
+		else if (!in_test && line_end - line >= 11 && strncmp(line, "#+begin_src", 11) == 0)
+		{
+			in_test = true;
+			count = 0;
+		}
+		else if (in_test && line_end - line >= 9 && strncmp(line, "#+end_src", 9) == 0)
+		{
+			in_test = false;
+			compile_test(corpus, name, name_length, lines, line_ends, count);
+		}
+		else if (in_test && count < LINE_LIMIT)
+		{
+			lines[count] = line;
+			line_ends[count++] = line_end;
+		}
+
+		line = (newline != NULL) ? newline + 1 : end;
+	}
+
+	unmap_file(&plan);
+	free(lines);
+	free(line_ends);
+	return true;
+}
+
+void free_corpus(conformance_corpus *corpus)
+{
+	free(corpus->text);
+	free(corpus->tests);
+	memset(corpus, 0, sizeof(conformance_corpus));
+}
+
+// cuts text into lines in place, each one stripped, leaving out the
+// trailing empty ones, the way testris.py reads the program's output
+static int split_lines(char *text, size_t size, char **lines)
+{
+	char *end = text + size;
+	char *line = text;
+	int count = 0;
+
+	while (line < end)
+	{
+		char *newline = (char *)memchr(line, '\n', end - line);
+		char *line_end = (newline != NULL) ? newline : end;
+		const char *stripped_end;
+
+		lines[count] = (char *)strip(line, line_end, &stripped_end);
+		*(char *)stripped_end = '\0';
+		count++;
+		line = line_end + 1;
+	}
+
+	while (count > 0 && lines[count - 1][0] == '\0')
+	{
+		count--;
+	}
+
+	return count;
+}
+
+// The output matches when its lines, stripped and without the trailing
+// empty ones, are the expected lines. The actual output is kept for the
+// report.
+static bool run_test(const conformance_corpus *corpus, int index, output_sink *actual)
+{
+	const conformance_test *test = corpus->tests + index;
+	command_source source;
+	char *copy;
+	char **lines;
+	int count;
+	bool passed;
+
+	init_buffer_source(&source, corpus->text + test->input, test->input_length);
+	init_memory_output(actual);
+	game_loop(&source, actual);
+
+	copy = (char *)malloc(actual->size + 1);
+	lines = (char **)malloc((actual->size + 1) * sizeof(char *));
+	if (copy == NULL || lines == NULL)
+	{
+		free(copy);
+		free(lines);
+		return false;
+	}
+
+	if (actual->size > 0)
+	{
+		memcpy(copy, actual->data, actual->size);
+	}
+	count = split_lines(copy, actual->size, lines);
+
+	passed = (count == test->expected_lines);
+	for (int i = 0, offset = test->expected; passed && i < count; i++)
+	{
+		const char *expected = corpus->text + offset;
+		size_t length = strcspn(expected, "\n");
+
+		passed = strlen(lines[i]) == length && memcmp(lines[i], expected, length) == 0;
+		offset += (int)length + 1;
+	}
+
+	free(copy);
+	free(lines);
+	return passed;
+}
+
+static void conformance_worker(void *argument)
+{
+	conformance_run *run = (conformance_run *)argument;
+
+	for (;;)
+	{
+		int index;
+
+		acquire_lock(&(run->lock));
+		index = run->next++;
+		release_lock(&(run->lock));
+
+		if (index >= run->corpus->count)
+		{
+			return;
+		}
+
+		run->results[index].passed = run_test(run->corpus, index,
+			&(run->results[index].actual));
+	}
+}
+
+// difflib.Differ's line markers: "  " both, "- " only in the actual
+// output, "+ " only in the expected; picked from a longest common
+// subsequence, without Differ's "? " hint lines
+static void print_diff(char **actual, int actual_count, char **expected, int expected_count)
+{
+	int width = expected_count + 1;
+	int *common = (int *)calloc((size_t)(actual_count + 1) * width, sizeof(int));
+	int i = 0, j = 0;
+
+	if (common == NULL)
+	{
+		return;
+	}
+
+	for (int a = actual_count - 1; a >= 0; a--)
+	{
+		for (int b = expected_count - 1; b >= 0; b--)
+		{
+			if (strcmp(actual[a], expected[b]) == 0)
+			{
+				common[a * width + b] = common[(a + 1) * width + b + 1] + 1;
+			}
+			else
+			{
+				int down = common[(a + 1) * width + b];
+				int right = common[a * width + b + 1];
+
+				common[a * width + b] = (down > right) ? down : right;
+			}
+		}
+	}
+
+	while (i < actual_count || j < expected_count)
+	{
+		if (i < actual_count && j < expected_count && strcmp(actual[i], expected[j]) == 0)
+		{
+			printf("  %s\n", actual[i++]);
+			j++;
+		}
+		else if (j == expected_count
+			|| (i < actual_count && common[(i + 1) * width + j] >= common[i * width + j + 1]))
+		{
+			printf("- %s\n", actual[i++]);
+		}
+		else
+		{
+			printf("+ %s\n", expected[j++]);
+		}
+	}
+
+	free(common);
+}
+
+// what testris.py prints for a failed test
+static void report_failure(const conformance_corpus *corpus, int index, output_sink *actual)
+{
+	const conformance_test *test = corpus->tests + index;
+	size_t expected_length = strlen(corpus->text + test->expected);
+	char *actual_text = (char *)malloc(actual->size + 1);
+	char *expected_text = (char *)malloc(expected_length + 1);
+	char **actual_lines = (char **)malloc((actual->size + 1) * sizeof(char *));
+	char **expected_lines = (char **)malloc((expected_length + 1) * sizeof(char *));
+	int actual_count, expected_count;
+
+	printf("Running test %d: %s\n", index + 1, corpus->text + test->name);
+	printf("%s\n", corpus->text + test->title);
+	printf("---- sending commands ----\n");
+	fwrite(corpus->text + test->input, 1, test->input_length, stdout);
+	printf("---- awaiting results ----\n");
+	printf("%s\n", corpus->text + test->doc);
+	printf("---- expected results ----\n");
+	printf("%s\n", corpus->text + test->expected);
+	printf("Test %d failed: output mismatch:\n", index + 1);
+
+	if (actual_text != NULL && expected_text != NULL
+		&& actual_lines != NULL && expected_lines != NULL)
+	{
+		if (actual->size > 0)
+		{
+			memcpy(actual_text, actual->data, actual->size);
+		}
+		memcpy(expected_text, corpus->text + test->expected, expected_length);
+		actual_count = split_lines(actual_text, actual->size, actual_lines);
+		expected_count = split_lines(expected_text, expected_length, expected_lines);
+		print_diff(actual_lines, actual_count, expected_lines, expected_count);
+	}
+
+	free(actual_text);
+	free(expected_text);
+	free(actual_lines);
+	free(expected_lines);
+}
+
+// learntris --conformance [testplan.org] [--threads n]
+// Runs every test in the plan inside this process, spread over the
+// cores, then reports them in order the way testris.py does, stopping
+// at the first failure. Exits with 1 if a test failed.
+int conformance_main(int argc, char *argv[])
+{
+	const char *path = "testplan.org";
+	int threads = 0;
+	conformance_corpus corpus;
+	conformance_run run;
+	thread_handle *workers;
+	bool *started;
+	int status = 0;
+	double start;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (argv[i][0] != '-')
+		{
+			path = argv[i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s --conformance [testplan.org] [--threads n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	start = seconds_now();
+	if (!compile_testplan(path, &corpus))
+	{
+		fprintf(stderr, "cannot read %s\n", path);
+		return 1;
+	}
+
+	if (threads <= 0)
+	{
+		threads = count_cpus();
+	}
+	if (threads > corpus.count)
+	{
+		threads = (corpus.count > 0) ? corpus.count : 1;
+	}
+
+	run.corpus = &corpus;
+	run.results = (conformance_result *)calloc(corpus.count + 1, sizeof(conformance_result));
+	run.next = 0;
+	workers = (thread_handle *)malloc(threads * sizeof(thread_handle));
+	started = (bool *)calloc(threads, sizeof(bool));
+	if (run.results == NULL || workers == NULL || started == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(run.results);
+		free(workers);
+		free(started);
+		free_corpus(&corpus);
+		return 1;
+	}
+	init_lock(&(run.lock));
+
+	// this thread works too, so the runs still finish if no
+	// thread can be started
+	for (int i = 1; i < threads; i++)
+	{
+		started[i] = start_thread(workers + i, conformance_worker, &run);
+	}
+	conformance_worker(&run);
+	for (int i = 1; i < threads; i++)
+	{
+		if (started[i])
+		{
+			join_thread(workers + i);
+		}
+	}
+
+	for (int i = 0; i < corpus.count; i++)
+	{
+		if (!run.results[i].passed)
+		{
+			report_failure(&corpus, i, &(run.results[i].actual));
+			status = 1;
+			break;
+		}
+		printf("Test %d passed\n", i + 1);
+	}
+
+	fprintf(stderr, "%d tests on %d threads in %.1f ms\n", corpus.count, threads,
+		(seconds_now() - start) * 1000.0);
+
+	for (int i = 0; i < corpus.count; i++)
+	{
+		free_output(&(run.results[i].actual));
+	}
+	destroy_lock(&(run.lock));
+	free(run.results);
+	free(workers);
+	free(started);
+	free_corpus(&corpus);
+	return status;
+}
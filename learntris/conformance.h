@@ -0,0 +1,35 @@
+#ifndef LEARNTRIS_CONFORMANCE_H
+#define LEARNTRIS_CONFORMANCE_H
+
+#include <stddef.h>
+
+// One test case from testplan.org. Everything is an offset into the
+// corpus text, where each string is stored once, NUL terminated.
+typedef struct tag_conformance_test
+{
+	int name;
+	int title;
+	int doc;			// the ':' lines, joined with newlines
+	int input;			// the '>' lines, a newline after each
+	int input_length;
+	int expected;		// the expected lines, joined with newlines
+	int expected_lines;
+} conformance_test;
+
+// testplan.org compiled down to what the runner needs, read the same
+// way extract.py and testris.py read it
+typedef struct tag_conformance_corpus
+{
+	char *text;
+	size_t size;
+	size_t capacity;
+	conformance_test *tests;
+	int count;
+	int capacity_tests;
+} conformance_corpus;
+
+bool compile_testplan(const char *path, conformance_corpus *corpus);
+void free_corpus(conformance_corpus *corpus);
+int conformance_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,807 @@
+#include <ctype.h>
+#include <string.h>
+#include "learntris.h"
+#include "probe.h"
+
+static bool rotate_tetromino(tetromino *this_tetromino, matrix *this_matrix, int turn);
+
+const tetromino_pattern tetromino_patterns[] = 
+{
+	{
+		{
+			"...."
+			"cccc"
+			"...."
+			"....",
+			"..c."
+			"..c."
+			"..c."
+			"..c.",
+			"...."
+			"...."
+			"cccc"
+			"....",
+			".c.."
+			".c.."
+			".c.."
+			".c.."
+		},
+		4,
+		4
+	},
+	{
+		{
+			"b.."
+			"bbb"
+			"...",
+			".bb"
+			".b."
+			".b.",
+			"..."
+			"bbb"
+			"..b",
+			".b."
+			".b."
+			"bb."
+		},
+		3,
+		3
+	},
+	{
+		{
+			"..o"
+			"ooo"
+			"...",
+			".o."
+			".o."
+			".oo",
+			"..."
+			"ooo"
+			"o..",
+			"oo."
+			".o."
+			".o."
+		},
+		3,
+		3
+	},
+	{
+		{
+			"yy"
+			"yy",
+			"yy"
+			"yy",
+			"yy"
+			"yy",
+			"yy"
+			"yy"
+		},
+		2,
+		2
+	},
+	{
+		{
+			".gg"
+			"gg."
+			"...",
+			".g."
+			".gg"
+			"..g",
+			"..."
+			".gg"
+			"gg.",
+			"g.."
+			"gg."
+			".g."
+		},
+		3,
+		3
+	},
+	{
+		{
+			".m."
+			"mmm"
+			"...",
+			".m."
+			".mm"
+			".m.",
+			"..."
+			"mmm"
+			".m.",
+			".m."
+			"mm."
+			".m."
+		},
+		3,
+		3
+	},
+	{
+		{
+			"rr."
+			".rr"
+			"...",
+			"..r"
+			".rr"
+			".r.",
+			"..."
+			"rr."
+			".rr",
+			".r."
+			"rr."
+			"r.."
+		},
+		3,
+		3
+	}
+};
+
+// Super Rotation System kicks, [J L O S T Z or I][from][clockwise or
+// counterclockwise], as row and column offsets with rows counting down.
+// O rotates in place, so only ever needs the first one.
+static const kick_offset srs_kicks[2][TETROMINO_POSITIONS][2][SRS_KICKS] =
+{
+	{
+		{
+			{ { 0, 0 }, { 0, -1 }, { -1, -1 }, { 2, 0 }, { 2, -1 } },	// 0 -> R
+			{ { 0, 0 }, { 0, 1 }, { -1, 1 }, { 2, 0 }, { 2, 1 } }		// 0 -> L
+		},
+		{
+			{ { 0, 0 }, { 0, 1 }, { 1, 1 }, { -2, 0 }, { -2, 1 } },		// R -> 2
+			{ { 0, 0 }, { 0, 1 }, { 1, 1 }, { -2, 0 }, { -2, 1 } }		// R -> 0
+		},
+		{
+			{ { 0, 0 }, { 0, 1 }, { -1, 1 }, { 2, 0 }, { 2, 1 } },		// 2 -> L
+			{ { 0, 0 }, { 0, -1 }, { -1, -1 }, { 2, 0 }, { 2, -1 } }	// 2 -> R
+		},
+		{
+			{ { 0, 0 }, { 0, -1 }, { 1, -1 }, { -2, 0 }, { -2, -1 } },	// L -> 0
+			{ { 0, 0 }, { 0, -1 }, { 1, -1 }, { -2, 0 }, { -2, -1 } }	// L -> 2
+		}
+	},
+	{
+		{
+			{ { 0, 0 }, { 0, -2 }, { 0, 1 }, { 1, -2 }, { -2, 1 } },	// 0 -> R
+			{ { 0, 0 }, { 0, -1 }, { 0, 2 }, { -2, -1 }, { 1, 2 } }		// 0 -> L
+		},
+		{
+			{ { 0, 0 }, { 0, -1 }, { 0, 2 }, { -2, -1 }, { 1, 2 } },	// R -> 2
+			{ { 0, 0 }, { 0, 2 }, { 0, -1 }, { -1, 2 }, { 2, -1 } }		// R -> 0
+		},
+		{
+			{ { 0, 0 }, { 0, 2 }, { 0, -1 }, { -1, 2 }, { 2, -1 } },	// 2 -> L
+			{ { 0, 0 }, { 0, 1 }, { 0, -2 }, { 2, 1 }, { -1, -2 } }		// 2 -> R
+		},
+		{
+			{ { 0, 0 }, { 0, 1 }, { 0, -2 }, { 2, 1 }, { -1, -2 } },	// L -> 0
+			{ { 0, 0 }, { 0, -2 }, { 0, 1 }, { 1, -2 }, { -2, 1 } }		// L -> 2
+		}
+	}
+};
+
+const tetromino_masks tetromino_mask_table[] =
+{
+	{	// I
+		{
+			{ { 0x0, 0xf, 0x0, 0x0 }, { 0x2, 0x2, 0x2, 0x2 }, 1, 1, 0, 3 },
+			{ { 0x4, 0x4, 0x4, 0x4 }, { 0x0, 0x0, 0xf, 0x0 }, 0, 3, 2, 2 },
+			{ { 0x0, 0x0, 0xf, 0x0 }, { 0x4, 0x4, 0x4, 0x4 }, 2, 2, 0, 3 },
+			{ { 0x2, 0x2, 0x2, 0x2 }, { 0x0, 0xf, 0x0, 0x0 }, 0, 3, 1, 1 }
+		},
+		3,
+		cyan
+	},
+	{	// J
+		{
+			{ { 0x1, 0x7, 0x0, 0x0 }, { 0x3, 0x2, 0x2, 0x0 }, 0, 1, 0, 2 },
+			{ { 0x6, 0x2, 0x2, 0x0 }, { 0x0, 0x7, 0x1, 0x0 }, 0, 2, 1, 2 },
+			{ { 0x0, 0x7, 0x4, 0x0 }, { 0x2, 0x2, 0x6, 0x0 }, 1, 2, 0, 2 },
+			{ { 0x2, 0x2, 0x3, 0x0 }, { 0x4, 0x7, 0x0, 0x0 }, 0, 2, 0, 1 }
+		},
+		3,
+		blue
+	},
+	{	// L
+		{
+			{ { 0x4, 0x7, 0x0, 0x0 }, { 0x2, 0x2, 0x3, 0x0 }, 0, 1, 0, 2 },
+			{ { 0x2, 0x2, 0x6, 0x0 }, { 0x0, 0x7, 0x4, 0x0 }, 0, 2, 1, 2 },
+			{ { 0x0, 0x7, 0x1, 0x0 }, { 0x6, 0x2, 0x2, 0x0 }, 1, 2, 0, 2 },
+			{ { 0x3, 0x2, 0x2, 0x0 }, { 0x1, 0x7, 0x0, 0x0 }, 0, 2, 0, 1 }
+		},
+		3,
+		orange
+	},
+	{	// O
+		{
+			{ { 0x3, 0x3, 0x0, 0x0 }, { 0x3, 0x3, 0x0, 0x0 }, 0, 1, 0, 1 },
+			{ { 0x3, 0x3, 0x0, 0x0 }, { 0x3, 0x3, 0x0, 0x0 }, 0, 1, 0, 1 },
+			{ { 0x3, 0x3, 0x0, 0x0 }, { 0x3, 0x3, 0x0, 0x0 }, 0, 1, 0, 1 },
+			{ { 0x3, 0x3, 0x0, 0x0 }, { 0x3, 0x3, 0x0, 0x0 }, 0, 1, 0, 1 }
+		},
+		4,
+		yellow
+	},
+	{	// S
+		{
+			{ { 0x6, 0x3, 0x0, 0x0 }, { 0x2, 0x3, 0x1, 0x0 }, 0, 1, 0, 2 },
+			{ { 0x2, 0x6, 0x4, 0x0 }, { 0x0, 0x3, 0x6, 0x0 }, 0, 2, 1, 2 },
+			{ { 0x0, 0x6, 0x3, 0x0 }, { 0x4, 0x6, 0x2, 0x0 }, 1, 2, 0, 2 },
+			{ { 0x1, 0x3, 0x2, 0x0 }, { 0x3, 0x6, 0x0, 0x0 }, 0, 2, 0, 1 }
+		},
+		3,
+		green
+	},
+	{	// T
+		{
+			{ { 0x2, 0x7, 0x0, 0x0 }, { 0x2, 0x3, 0x2, 0x0 }, 0, 1, 0, 2 },
+			{ { 0x2, 0x6, 0x2, 0x0 }, { 0x0, 0x7, 0x2, 0x0 }, 0, 2, 1, 2 },
+			{ { 0x0, 0x7, 0x2, 0x0 }, { 0x2, 0x6, 0x2, 0x0 }, 1, 2, 0, 2 },
+			{ { 0x2, 0x3, 0x2, 0x0 }, { 0x2, 0x7, 0x0, 0x0 }, 0, 2, 0, 1 }
+		},
+		3,
+		magenta
+	},
+	{	// Z
+		{
+			{ { 0x3, 0x6, 0x0, 0x0 }, { 0x1, 0x3, 0x2, 0x0 }, 0, 1, 0, 2 },
+			{ { 0x4, 0x6, 0x2, 0x0 }, { 0x0, 0x6, 0x3, 0x0 }, 0, 2, 1, 2 },
+			{ { 0x0, 0x3, 0x6, 0x0 }, { 0x2, 0x6, 0x4, 0x0 }, 1, 2, 0, 2 },
+			{ { 0x2, 0x3, 0x1, 0x0 }, { 0x6, 0x3, 0x0, 0x0 }, 0, 2, 0, 1 }
+		},
+		3,
+		red
+	}
+
+};
+
+void init(game_state *this_game_state)
+{
+	clear_matrix(&(this_game_state->main_matrix));
+
+	this_game_state->score = 0;
+	this_game_state->num_lines = 0;
+
+	this_game_state->active_tetromino.type = illegal_tetromino;
+	this_game_state->active_tetromino.position = -1;
+	this_game_state->active_tetromino.location.top = -1;
+	this_game_state->active_tetromino.location.left = -1;
+}
+
+void clear_row(matrix *this_matrix, int row)
+{
+	this_matrix->rows[row] = 0;
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		this_matrix->columns[col] &= ~(1u << row);
+	}
+	memset(this_matrix->squares + MATRIX_WIDTH * row, empty, MATRIX_WIDTH);
+}
+
+// writes the occupancy of a row, keeping the columns in step; the
+// colors are left alone
+void set_row(matrix *this_matrix, int row, row_bitfield bits)
+{
+	this_matrix->rows[row] = bits;
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		if ((bits & (1 << col)) != 0)
+		{
+			this_matrix->columns[col] |= 1u << row;
+		}
+		else
+		{
+			this_matrix->columns[col] &= ~(1u << row);
+		}
+	}
+}
+
+void clear_matrix(matrix *this_matrix)
+{
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		clear_row(this_matrix, row);
+	}
+	this_matrix->squares[MATRIX_WIDTH * MATRIX_DEPTH] = '\0';
+	memset(this_matrix->columns, 0, sizeof(this_matrix->columns));
+	this_matrix->touched_rows = 0;
+}
+
+bool check_square_value(char value)
+{
+	return (value == empty || value == red || value == green
+		|| value == blue || value == orange || value == cyan
+		|| value == magenta || value == yellow);
+}
+
+bool row_full(matrix *this_matrix, int row)
+{
+	return this_matrix->rows[row] == FULL_ROW;
+}
+
+// only the rows a piece (or an input) has touched since the last step
+// can be full, so those are the only ones checked
+void exec_step(game_state *this_game_state)
+{
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	unsigned int touched = this_matrix->touched_rows;
+	unsigned int full_rows = 0;
+	int cleared;
+
+	for (int row = 0; touched >> row != 0; row++)
+	{
+		if ((touched & (1u << row)) != 0 && row_full(this_matrix, row))
+		{
+			full_rows |= 1u << row;
+		}
+	}
+	this_matrix->touched_rows = 0;
+
+	if (full_rows == 0)
+	{
+		return;
+	}
+
+	cleared = count_bits(full_rows);
+	PROBE_ADD(probe_rows_cleared, cleared);
+	this_game_state->num_lines += cleared;
+	this_game_state->score += 100 * cleared;
+
+	PROBE_BEGIN("collapse");
+	collapse_rows(this_matrix, full_rows);
+	PROBE_END("collapse");
+}
+
+// Removes the rows in full_rows and lets everything above them fall.
+// Walks up from the lowest full row, moving each run of kept rows down
+// as one block by the number of full rows found below it so far.
+void collapse_rows(matrix *this_matrix, unsigned int full_rows)
+{
+	int drop = 0;
+	int row = MATRIX_DEPTH - 1;
+
+	// the columns first, top to bottom, so the full rows still to go
+	// have not moved yet
+	for (unsigned int full = full_rows; full != 0; full &= full - 1)
+	{
+		unsigned int above = (1u << lowest_bit(full)) - 1;
+
+		for (int col = 0; col < MATRIX_WIDTH; col++)
+		{
+			unsigned int bits = this_matrix->columns[col];
+
+			this_matrix->columns[col] = (bits & ~(above | (above + 1)))
+				| ((bits & above) << 1);
+		}
+	}
+
+	while (row >= 0)
+	{
+		int bottom;
+
+		if ((full_rows & (1u << row)) != 0)
+		{
+			drop++;
+			row--;
+			continue;
+		}
+
+		bottom = row;
+		while (row >= 0 && (full_rows & (1u << row)) == 0)
+		{
+			row--;
+		}
+
+		if (drop > 0)
+		{
+			int top = row + 1;
+			int count = bottom - top + 1;
+
+			memmove(this_matrix->rows + top + drop, this_matrix->rows + top,
+				count * sizeof(row_bitfield));
+			memmove(this_matrix->squares + MATRIX_WIDTH * (top + drop),
+				this_matrix->squares + MATRIX_WIDTH * top, count * MATRIX_WIDTH);
+		}
+	}
+
+	for (row = 0; row < drop; row++)
+	{
+		clear_row(this_matrix, row);
+	}
+}
+
+// Pushes everything up by count rows and fills the count rows at the
+// bottom with color, all but the hole column: the garbage an opponent
+// sends. Returns false if anything went out of the top, which ends the
+// game.
+bool insert_garbage(matrix *this_matrix, int count, int hole, char color)
+{
+	unsigned int bottom = ALL_ROWS & ~((1u << (MATRIX_DEPTH - count)) - 1);
+	row_bitfield bits = (row_bitfield)(FULL_ROW & ~(1 << hole));
+	bool pushed_out = false;
+
+	for (int row = 0; row < count; row++)
+	{
+		pushed_out = pushed_out || this_matrix->rows[row] != 0;
+	}
+
+	memmove(this_matrix->rows, this_matrix->rows + count,
+		(MATRIX_DEPTH - count) * sizeof(row_bitfield));
+	memmove(this_matrix->squares, this_matrix->squares + MATRIX_WIDTH * count,
+		(MATRIX_DEPTH - count) * MATRIX_WIDTH);
+
+	for (int row = MATRIX_DEPTH - count; row < MATRIX_DEPTH; row++)
+	{
+		this_matrix->rows[row] = bits;
+		memset(this_matrix->squares + MATRIX_WIDTH * row, color, MATRIX_WIDTH);
+		this_matrix->squares[MATRIX_WIDTH * row + hole] = empty;
+	}
+
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		this_matrix->columns[col] = (this_matrix->columns[col] >> count)
+			| ((col != hole) ? bottom : 0);
+	}
+	this_matrix->touched_rows >>= count;
+
+	return !pushed_out;
+}
+
+// rebuilds the columns from the rows, and marks the full rows for the
+// next step
+void sync_matrix(matrix *this_matrix)
+{
+	this_matrix->touched_rows = 0;
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		this_matrix->columns[col] = 0;
+	}
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		row_bitfield bits = this_matrix->rows[row];
+
+		if (bits == FULL_ROW)
+		{
+			this_matrix->touched_rows |= 1u << row;
+		}
+
+		for (; bits != 0; bits &= bits - 1)
+		{
+			this_matrix->columns[lowest_bit(bits)] |= 1u << row;
+		}
+	}
+}
+
+// number of filled rows from the floor up to the surface of the column
+int column_height(matrix *this_matrix, int col)
+{
+	unsigned int bits = this_matrix->columns[col];
+
+	return (bits == 0) ? 0 : MATRIX_DEPTH - lowest_bit(bits);
+}
+
+bool spawn_tetromino(tetromino *this_tetromino, int tetromino_type, matrix *this_matrix)
+{
+	this_tetromino->type = tetromino_type;
+	this_tetromino->position = 0;
+	this_tetromino->location.top = 0;
+	this_tetromino->location.left = tetromino_mask_table[tetromino_type].spawn_left;
+
+	if (check_collision_down(this_tetromino, this_matrix))
+	{
+		return false;
+	}
+	else
+	{
+		return true;
+	}
+}
+
+// Turns the tetromino by turn quarters clockwise (1, or 3 for
+// counterclockwise) and takes the first kick that fits. Each test is one
+// check_overlap, a row mask per row of the piece. Stays put and returns
+// false if none of them fit.
+static bool rotate_tetromino(tetromino *this_tetromino, matrix *this_matrix, int turn)
+{
+	int from = this_tetromino->position;
+	const kick_offset *kicks;
+
+	if (this_tetromino->type == illegal_tetromino || from < 0)
+	{
+		return false;
+	}
+
+	kicks = get_kicks(this_tetromino->type, from, turn);
+	this_tetromino->position = (from + turn) % TETROMINO_POSITIONS;
+	for (int kick = 0; kick < SRS_KICKS; kick++)
+	{
+		if (!check_overlap(this_tetromino, this_matrix, kicks[kick].top, kicks[kick].left))
+		{
+			this_tetromino->location.top += kicks[kick].top;
+			this_tetromino->location.left += kicks[kick].left;
+			return true;
+		}
+	}
+
+	this_tetromino->position = from;
+	return false;
+}
+
+bool rotate_right(tetromino *this_tetromino, matrix *this_matrix)
+{
+	return rotate_tetromino(this_tetromino, this_matrix, 1);
+}
+
+bool rotate_left(tetromino *this_tetromino, matrix *this_matrix)
+{
+	return rotate_tetromino(this_tetromino, this_matrix, TETROMINO_POSITIONS - 1);
+}
+
+// the kicks to try, in order, turning from position by turn quarters
+// clockwise (1 or 3)
+const kick_offset *get_kicks(int tetromino_type, int position, int turn)
+{
+	return srs_kicks[(tetromino_type == tetromino_I) ? 1 : 0][position][(turn == 1) ? 0 : 1];
+}
+
+const tetromino_shape *get_shape(tetromino *this_tetromino)
+{
+	return &(tetromino_mask_table[this_tetromino->type]
+		.shapes[this_tetromino->position]);
+}
+
+// Whether a tetromino from outside the engine, e.g. a log, is one it can
+// take: none at all, or a real type and rotation with every square
+// inside the matrix.
+bool valid_tetromino(tetromino *this_tetromino)
+{
+	const tetromino_shape *shape;
+	int top = this_tetromino->location.top;
+	int left = this_tetromino->location.left;
+
+	if (this_tetromino->type == illegal_tetromino)
+	{
+		return true;
+	}
+	if (this_tetromino->type < 0 || this_tetromino->type > tetromino_Z
+		|| this_tetromino->position < 0 || this_tetromino->position >= TETROMINO_POSITIONS)
+	{
+		return false;
+	}
+
+	shape = get_shape(this_tetromino);
+	return top + shape->top >= 0 && top + shape->bottom < MATRIX_DEPTH
+		&& left + shape->left >= 0 && left + shape->right < MATRIX_WIDTH;
+}
+
+row_bitfield shift_row(row_bitfield bits, int left)
+{
+	return (left >= 0) ? (row_bitfield)(bits << left) : (row_bitfield)(bits >> -left);
+}
+
+// Does the tetromino overlap a block or stick out of the matrix
+// after moving it by row_offset / col_offset?
+bool check_overlap(tetromino *this_tetromino, matrix *this_matrix, int row_offset, int col_offset)
+{
+	const tetromino_shape *shape = get_shape(this_tetromino);
+	int top = this_tetromino->location.top + row_offset;
+	int left = this_tetromino->location.left + col_offset;
+
+	PROBE_COUNT(probe_overlap_checks);
+	if (top + shape->top < 0 || top + shape->bottom >= MATRIX_DEPTH
+		|| left + shape->left < 0 || left + shape->right >= MATRIX_WIDTH)
+	{
+		return true;
+	}
+
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		if ((shift_row(shape->rows[row], left) & this_matrix->rows[top + row]) != 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool check_collision_right(tetromino *this_tetromino, matrix *this_matrix)
+{
+	return check_overlap(this_tetromino, this_matrix, 0, 1);
+}
+
+bool check_collision_left(tetromino *this_tetromino, matrix *this_matrix)
+{
+	return check_overlap(this_tetromino, this_matrix, 0, -1);
+}
+
+bool check_collision_down(tetromino *this_tetromino, matrix *this_matrix)
+{
+	PROBE_COUNT(probe_collisions_down);
+	return check_overlap(this_tetromino, this_matrix, 1, 0);
+}
+
+bool nudge_right(tetromino *this_tetromino, matrix *this_matrix)
+{
+	PROBE_COUNT(probe_nudge_attempts);
+	if (this_tetromino->type == illegal_tetromino
+		|| check_collision_right(this_tetromino, this_matrix))
+	{
+		return false;
+	}
+
+	this_tetromino->location.left++;
+	PROBE_COUNT(probe_nudges);
+	return true;
+}
+
+bool nudge_left(tetromino *this_tetromino, matrix *this_matrix)
+{
+	PROBE_COUNT(probe_nudge_attempts);
+	if (this_tetromino->type == illegal_tetromino
+		|| check_collision_left(this_tetromino, this_matrix))
+	{
+		return false;
+	}
+
+	this_tetromino->location.left--;
+	PROBE_COUNT(probe_nudges);
+	return true;
+}
+
+bool nudge_down(tetromino *this_tetromino, matrix *this_matrix)
+{
+	PROBE_COUNT(probe_nudge_attempts);
+	if (this_tetromino->type == illegal_tetromino
+		|| check_collision_down(this_tetromino, this_matrix))
+	{
+		return false;
+	}
+
+	this_tetromino->location.top++;
+	PROBE_COUNT(probe_nudges);
+	return true;
+}
+
+void insert_tetromino(matrix *this_matrix, tetromino *new_tetromino)
+{
+	const tetromino_shape *shape;
+
+	if (new_tetromino->type == illegal_tetromino
+		|| new_tetromino->position < 0)
+	{
+		return;
+	}
+
+	shape = get_shape(new_tetromino);
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		int y = new_tetromino->location.top + row;
+
+		// a rotation can leave part of the piece outside the matrix
+		if (y >= 0 && y < MATRIX_DEPTH)
+		{
+			row_bitfield bits = FULL_ROW
+				& shift_row(shape->rows[row], new_tetromino->location.left);
+
+			this_matrix->rows[y] |= bits;
+			this_matrix->touched_rows |= 1u << y;
+			for (; bits != 0; bits &= bits - 1)
+			{
+				this_matrix->columns[lowest_bit(bits)] |= 1u << y;
+			}
+		}
+	}
+
+	paint_tetromino(this_matrix, new_tetromino,
+		tetromino_mask_table[new_tetromino->type].color);
+}
+
+void paint_tetromino(matrix *this_matrix, tetromino *this_tetromino, char color)
+{
+	const tetromino_shape *shape = get_shape(this_tetromino);
+	int top = this_tetromino->location.top;
+	int left = this_tetromino->location.left;
+
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		for (int col = shape->left; col <= shape->right; col++)
+		{
+			if ((shape->rows[row] & (1 << col)) != 0
+				&& top + row >= 0 && top + row < MATRIX_DEPTH
+				&& left + col >= 0 && left + col < MATRIX_WIDTH)
+			{
+				this_matrix->squares[MATRIX_WIDTH * (top + row) + left + col] = color;
+			}
+		}
+	}
+}
+
+// How far the tetromino can fall, read off the column bitmasks instead
+// of trying one row at a time. Each column of a tetromino is a single
+// run of squares, so in each column it stops on the first filled square
+// under the top of that run.
+int drop_distance(tetromino *this_tetromino, matrix *this_matrix)
+{
+	const tetromino_shape *shape;
+	int top, left;
+	int distance = MATRIX_DEPTH;
+
+	if (this_tetromino->type == illegal_tetromino)
+	{
+		return 0;
+	}
+
+	shape = get_shape(this_tetromino);
+	top = this_tetromino->location.top;
+	left = this_tetromino->location.left;
+
+	// the same walls check_overlap would hit on the way down
+	if (top + shape->top + 1 < 0
+		|| left + shape->left < 0 || left + shape->right >= MATRIX_WIDTH)
+	{
+		return 0;
+	}
+
+	for (int col = shape->left; col <= shape->right; col++)
+	{
+		unsigned int squares = shape->columns[col];
+		int first = top + lowest_bit(squares) + 1;
+		int bottom = top + highest_bit(squares);
+		unsigned int below = (first < MATRIX_DEPTH)
+			? this_matrix->columns[left + col] >> first : 0;
+		int stop = (below == 0) ? MATRIX_DEPTH : first + lowest_bit(below);
+
+		PROBE_COUNT(probe_column_scans);
+
+		if (stop - bottom - 1 < distance)
+		{
+			distance = stop - bottom - 1;
+		}
+	}
+
+	return (distance < 0) ? 0 : distance;
+}
+
+bool drop_tetromino(game_state *this_game_state)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+
+	active_tetromino->location.top += drop_distance(active_tetromino,
+		&(this_game_state->main_matrix));
+
+	return lock_tetromino(this_game_state);
+}
+
+// Locks the active tetromino where it is. Returns false if it locked
+// in the top row, which ends the game.
+bool lock_tetromino(game_state *this_game_state)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+
+	PROBE_COUNT(probe_locks);
+	PROBE_BEGIN("lock");
+	insert_tetromino(&(this_game_state->main_matrix), active_tetromino);
+	PROBE_END("lock");
+
+	active_tetromino->type = illegal_tetromino;
+
+	return (active_tetromino->location.top > 0);
+}
+
+// Moves the active tetromino straight to a placement returned by
+// find_placements and locks it there.
+bool play_placement(game_state *this_game_state, const placement *target)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+
+	if (active_tetromino->type == illegal_tetromino)
+	{
+		return false;
+	}
+
+	active_tetromino->position = target->position;
+	active_tetromino->location.top = target->top;
+	active_tetromino->location.left = target->left;
+
+	return lock_tetromino(this_game_state);
+}
@@ -0,0 +1,149 @@
+#include "evaluator.h"
+
+// the same score as standard_evaluator with default_weights
+const feature_weights default_feature_weights = { { -51, -36, -18, 0, 0, 0, 76 } };
+
+static unsigned int remove_rows(unsigned int column, unsigned int rows);
+static inline unsigned long long byte_counts(unsigned long long x);
+static inline int sum_bytes(unsigned long long counts);
+static inline unsigned long long column_pair(unsigned int low, unsigned int high);
+
+// Takes rows out of a column word, letting the ones above fall. Going
+// from the top, taking a row out never moves the ones still to go.
+static unsigned int remove_rows(unsigned int column, unsigned int rows)
+{
+	for (; rows != 0; rows &= rows - 1)
+	{
+		unsigned int above = (1u << lowest_bit(rows)) - 1;
+
+		column = (column & ~((above << 1) | 1)) | ((column & above) << 1);
+	}
+
+	return column;
+}
+
+// Counts bits a byte at a time: every byte of the result holds the
+// count of its byte of x, at most 8. These add up across up to 31 words
+// before a byte can overflow, so a feature takes one horizontal sum
+// however many words go into it.
+static inline unsigned long long byte_counts(unsigned long long x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+}
+
+static inline int sum_bytes(unsigned long long counts)
+{
+	return (int)((counts * 0x0101010101010101ULL) >> 56);
+}
+
+// two column words in one, the odd column in the high half
+static inline unsigned long long column_pair(unsigned int low, unsigned int high)
+{
+	return low | ((unsigned long long)high << 32);
+}
+
+// Everything comes from the column words, a bit per row, two to a 64 bit
+// word: a height is a count of trailing zeros, holes and transitions are
+// population counts. Rows that are full, which the last lock filled and
+// no step has cleared yet, are taken out first and counted as cleared
+// lines.
+void compute_features(matrix *this_matrix, int lines_cleared, board_features *features)
+{
+	const unsigned long long all_rows = column_pair(ALL_ROWS, ALL_ROWS);
+	const unsigned long long floor_rows = column_pair(1u << MATRIX_DEPTH, 1u << MATRIX_DEPTH);
+	unsigned int columns[MATRIX_WIDTH + 1];
+	int heights[MATRIX_WIDTH];
+	unsigned int full = ALL_ROWS;
+	unsigned int occupied = 0;
+	unsigned int counted;
+	unsigned long long filled = 0, column_changes = 0, row_changes;
+	int *values = features->values;
+
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		full &= this_matrix->columns[col];
+	}
+
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		unsigned int column = this_matrix->columns[col];
+
+		if (full != 0)
+		{
+			column = remove_rows(column, full);
+		}
+		columns[col] = column;
+		occupied |= column;
+	}
+
+	values[feature_height] = 0;
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		heights[col] = (columns[col] != 0) ? MATRIX_DEPTH - lowest_bit(columns[col]) : 0;
+		values[feature_height] += heights[col];
+	}
+
+	// a column changes wherever a row differs from the one below it
+	for (int col = 0; col < MATRIX_WIDTH; col += 2)
+	{
+		unsigned long long pair = column_pair(columns[col], columns[col + 1]);
+		unsigned long long floored = pair | floor_rows;
+
+		filled += byte_counts(pair);
+		column_changes += byte_counts((floored ^ (floored >> 1)) & all_rows);
+	}
+	values[feature_holes] = values[feature_height] - sum_bytes(filled);
+	values[feature_column_transitions] = sum_bytes(column_changes);
+
+	// The rows from the highest filled one down. A row changes wherever
+	// a column differs from the one to its left, the walls filled: the
+	// differences from column 0 to the right wall, paired with the one
+	// from the left wall.
+	counted = (occupied != 0) ? ALL_ROWS & ~((1u << lowest_bit(occupied)) - 1) : 0;
+	columns[MATRIX_WIDTH] = ALL_ROWS;
+	row_changes = byte_counts(column_pair(~columns[0] & counted, 0));
+	for (int col = 0; col < MATRIX_WIDTH; col += 2)
+	{
+		row_changes += byte_counts(column_pair((columns[col] ^ columns[col + 1]) & counted,
+			(columns[col + 1] ^ columns[col + 2]) & counted));
+	}
+	values[feature_row_transitions] = sum_bytes(row_changes);
+
+	values[feature_bumpiness] = 0;
+	values[feature_wells] = 0;
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		int left = (col > 0) ? heights[col - 1] : MATRIX_DEPTH;
+		int right = (col < MATRIX_WIDTH - 1) ? heights[col + 1] : MATRIX_DEPTH;
+		int rim = (left < right) ? left : right;
+
+		if (col < MATRIX_WIDTH - 1)
+		{
+			values[feature_bumpiness] += (heights[col] > right) ? heights[col] - right : right - heights[col];
+		}
+		if (rim > heights[col])
+		{
+			values[feature_wells] += rim - heights[col];
+		}
+	}
+
+	values[feature_lines] = lines_cleared + count_bits(full);
+}
+
+// a board_evaluator, with settings a feature_weights
+int feature_evaluator(matrix *this_matrix, int lines_cleared, const void *settings)
+{
+	const feature_weights *weights = (const feature_weights *)settings;
+	board_features features;
+	int score = 0;
+
+	compute_features(this_matrix, lines_cleared, &features);
+	for (int kind = 0; kind < feature_count; kind++)
+	{
+		score += weights->values[kind] * features.values[kind];
+	}
+
+	return score;
+}
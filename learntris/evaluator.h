@@ -0,0 +1,38 @@
+#ifndef LEARNTRIS_EVALUATOR_H
+#define LEARNTRIS_EVALUATOR_H
+
+#include "learntris.h"
+
+// the board features, in the order '?e' prints them
+enum board_feature_kinds
+{
+	feature_height,				// sum of the column heights
+	feature_holes,				// empty squares under the surface of their column
+	feature_bumpiness,			// sum of the height differences between neighbours
+	feature_row_transitions,	// filled/empty changes along the rows from the
+								// highest filled one down, the walls filled
+	feature_column_transitions,	// filled/empty changes down the columns, the
+								// floor filled
+	feature_wells,				// how far each column is below both neighbours,
+								// the walls as high as the matrix
+	feature_lines,				// lines cleared on the way to the board
+	feature_count
+};
+
+typedef struct tag_board_features
+{
+	int values[feature_count];
+} board_features;
+
+// a weight per feature; a board scores the sum of weight times value
+typedef struct tag_feature_weights
+{
+	int values[feature_count];
+} feature_weights;
+
+extern const feature_weights default_feature_weights;
+
+void compute_features(matrix *this_matrix, int lines_cleared, board_features *features);
+int feature_evaluator(matrix *this_matrix, int lines_cleared, const void *settings);
+
+#endif
@@ -0,0 +1,757 @@
+#include <ctype.h>
+#include <string.h>
+#include "frontend.h"
+#include "evaluator.h"
+
+// what a byte does in mode_play
+typedef void (*command_handler)(session *this_session, int command, output_sink *out);
+
+static void do_blank(session *this_session, int command, output_sink *out);
+static void do_unknown(session *this_session, int command, output_sink *out);
+static void do_title(session *this_session, int command, output_sink *out);
+static void do_pause(session *this_session, int command, output_sink *out);
+static void do_quit(session *this_session, int command, output_sink *out);
+static void do_print(session *this_session, int command, output_sink *out);
+static void do_print_all(session *this_session, int command, output_sink *out);
+static void do_clear(session *this_session, int command, output_sink *out);
+static void do_given(session *this_session, int command, output_sink *out);
+static void do_step(session *this_session, int command, output_sink *out);
+static void do_undo(session *this_session, int command, output_sink *out);
+static void do_redo(session *this_session, int command, output_sink *out);
+static void do_show(session *this_session, int command, output_sink *out);
+static void do_spawn(session *this_session, int command, output_sink *out);
+static void do_spawn_next(session *this_session, int command, output_sink *out);
+static void do_number(session *this_session, int command, output_sink *out);
+static void do_rotate_right(session *this_session, int command, output_sink *out);
+static void do_rotate_left(session *this_session, int command, output_sink *out);
+static void do_right(session *this_session, int command, output_sink *out);
+static void do_left(session *this_session, int command, output_sink *out);
+static void do_down(session *this_session, int command, output_sink *out);
+static void do_drop(session *this_session, int command, output_sink *out);
+static void do_newline(session *this_session, int command, output_sink *out);
+static void do_query(session *this_session, int command, output_sink *out);
+static void query_command(session *this_session, int command, output_sink *out);
+static void menu_command(session *this_session, int command, output_sink *out);
+static const unsigned char *input_squares(session *this_session,
+	const unsigned char *next, const unsigned char *end);
+static const unsigned char *input_number(session *this_session,
+	const unsigned char *next, const unsigned char *end);
+void display_title(output_sink *out);
+void display_score(game_state *this_game_state, output_sink *out);
+void display_num_lines(game_state *this_game_state, output_sink *out);
+void display_tetromino(tetromino *this_tetromino, output_sink *out);
+void print_all(game_state *this_game_state, output_sink *out);
+void display_placements(game_state *this_game_state, output_sink *out);
+void display_ghost(game_state *this_game_state, output_sink *out);
+void display_features(game_state *this_game_state, output_sink *out);
+void display_latency(latency_stats *this_stats, output_sink *out);
+void display_preview(piece_bag *this_bag, output_sink *out);
+void game_over(output_sink *out);
+void unknown_command(int command, output_sink *out);
+
+// every byte value, eight to a line
+static const command_handler command_table[256] =
+{
+	do_blank, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 00
+	do_unknown, do_blank, do_blank, do_blank, do_blank, do_blank, do_unknown, do_unknown,	// 08
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 10
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 18
+	do_blank, do_pause, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 20 !"#$%&'
+	do_rotate_left, do_rotate_right, do_unknown, do_number, do_unknown, do_unknown, do_unknown, do_unknown,	// 28 ()*+,-./
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 30 01234567
+	do_unknown, do_unknown, do_unknown, do_newline, do_left, do_unknown, do_right, do_query,	// 38 89:;<=>?
+	do_title, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 40 @ABCDEFG
+	do_unknown, do_spawn, do_spawn, do_unknown, do_spawn, do_unknown, do_spawn_next, do_spawn,	// 48 HIJKLMNO
+	do_print_all, do_unknown, do_number, do_spawn, do_spawn, do_unknown, do_drop, do_unknown,	// 50 PQRSTUVW
+	do_unknown, do_unknown, do_spawn, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 58 XYZ[\]^_
+	do_unknown, do_unknown, do_unknown, do_clear, do_unknown, do_unknown, do_unknown, do_given,	// 60 `abcdefg
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 68 hijklmno
+	do_print, do_quit, do_redo, do_step, do_show, do_undo, do_down, do_unknown,	// 70 pqrstuvw
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 78 xyz{|}~
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 80
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 88
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 90
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// 98
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// A0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// A8
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// B0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// B8
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// C0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// C8
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// D0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// D8
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// E0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// E8
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown,	// F0
+	do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown, do_unknown	// F8
+};
+
+// the spawn commands, in tetromino_types order
+static const char spawn_commands[] = "IJLOSTZ";
+
+void init_session(session *this_session)
+{
+	init(&(this_session->state));
+	init_history(&(this_session->moves));
+	this_session->mode = mode_play;
+	this_session->next_square = 0;
+	this_session->number_command = 0;
+	this_session->number = 0;
+	this_session->title_displayed = false;
+	this_session->game_is_over = false;
+	reset_latency(&(this_session->latency));
+	init_bag(&(this_session->pieces), seed_random(0, 0), BAG_DEFAULT_PREVIEW);
+}
+
+// Runs the text protocol over length bytes of commands, which may stop
+// anywhere, even in the middle of a '?' or a matrix. Returns how many
+// bytes were used: all of them, unless the game quit first.
+size_t feed_commands(session *this_session, const unsigned char *commands, size_t length,
+	output_sink *out)
+{
+	const unsigned char *next = commands;
+	const unsigned char *end = commands + length;
+
+	while (next < end)
+	{
+		switch (this_session->mode)
+		{
+		case mode_play:
+			do
+			{
+				next = skip_blanks(next, end);
+				if (next == end)
+				{
+					break;
+				}
+				command_table[*next](this_session, *next, out);
+				next++;
+			} while (next < end && this_session->mode == mode_play);
+			break;
+		case mode_query:
+			this_session->mode = mode_play;
+			query_command(this_session, *next++, out);
+			break;
+		case mode_paused:
+			next = (const unsigned char *)memchr(next, '!', end - next);
+			if (next == NULL)
+			{
+				return length;
+			}
+			this_session->mode = mode_play;
+			next++;
+			break;
+		case mode_menu:
+			next = skip_blanks(next, end);
+			if (next < end)
+			{
+				menu_command(this_session, *next++, out);
+			}
+			break;
+		case mode_matrix:
+			next = input_squares(this_session, next, end);
+			break;
+		case mode_number:
+			next = input_number(this_session, next, end);
+			break;
+		default:
+			return next - commands;
+		}
+	}
+
+	return next - commands;
+}
+
+void game_loop(command_source *source, output_sink *out)
+{
+	session my_session;
+
+	init_session(&my_session);
+
+	while (my_session.mode != mode_quit
+		&& (source->next < source->end || refill_source(source)))
+	{
+		source->next += feed_commands(&my_session, source->next, source->end - source->next, out);
+	}
+}
+
+// blanks never get here from feed_commands; they are in the table so
+// that every byte has a handler
+static void do_blank(session *this_session, int command, output_sink *out)
+{
+}
+
+static void do_unknown(session *this_session, int command, output_sink *out)
+{
+	unknown_command(command, out);
+}
+
+static void do_title(session *this_session, int command, output_sink *out)
+{
+	display_title(out);
+	this_session->title_displayed = true;
+}
+
+static void do_pause(session *this_session, int command, output_sink *out)
+{
+	write_text(out, "Paused\nPress start button to continue.\n");
+	this_session->mode = mode_paused;
+}
+
+static void do_quit(session *this_session, int command, output_sink *out)
+{
+	this_session->mode = mode_quit;
+}
+
+static void do_print(session *this_session, int command, output_sink *out)
+{
+	if (this_session->title_displayed)
+	{
+		write_text(out, "Press start button to begin.\n");
+		this_session->mode = mode_menu;
+		this_session->title_displayed = false;
+	}
+	else
+	{
+		unsigned long long started = start_latency(&(this_session->latency), latency_print);
+
+		print_matrix(&(this_session->state.main_matrix), out);
+		if (this_session->game_is_over)
+		{
+			game_over(out);
+		}
+		stop_latency(&(this_session->latency), latency_print, started);
+	}
+}
+
+static void do_print_all(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_print);
+
+	print_all(&(this_session->state), out);
+	if (this_session->game_is_over)
+	{
+		game_over(out);
+	}
+	stop_latency(&(this_session->latency), latency_print, started);
+}
+
+static void do_clear(session *this_session, int command, output_sink *out)
+{
+	clear_matrix(&(this_session->state.main_matrix));
+	init_history(&(this_session->moves));
+}
+
+static void do_given(session *this_session, int command, output_sink *out)
+{
+	init_history(&(this_session->moves));
+	this_session->mode = mode_matrix;
+	this_session->next_square = 0;
+}
+
+static void do_step(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_step);
+
+	history_step(&(this_session->moves), &(this_session->state), &(this_session->game_is_over));
+	stop_latency(&(this_session->latency), latency_step, started);
+}
+
+static void do_undo(session *this_session, int command, output_sink *out)
+{
+	undo(&(this_session->moves), &(this_session->state), &(this_session->game_is_over));
+}
+
+static void do_redo(session *this_session, int command, output_sink *out)
+{
+	redo(&(this_session->moves), &(this_session->state), &(this_session->game_is_over));
+}
+
+static void do_show(session *this_session, int command, output_sink *out)
+{
+	display_tetromino(&(this_session->state.active_tetromino), out);
+}
+
+static void do_spawn(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_spawn);
+	int type = (int)(strchr(spawn_commands, command) - spawn_commands);
+
+	if (!spawn_tetromino(&(this_session->state.active_tetromino), type,
+		&(this_session->state.main_matrix)))
+	{
+		this_session->game_is_over = true;
+	}
+	stop_latency(&(this_session->latency), latency_spawn, started);
+}
+
+// the next piece from the bag
+static void do_spawn_next(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_spawn);
+
+	if (!spawn_tetromino(&(this_session->state.active_tetromino), next_piece(&(this_session->pieces)),
+		&(this_session->state.main_matrix)))
+	{
+		this_session->game_is_over = true;
+	}
+	stop_latency(&(this_session->latency), latency_spawn, started);
+}
+
+// 'R' reseeds the bag and '+' sets how many pieces '?q' shows, both
+// with the number that follows
+static void do_number(session *this_session, int command, output_sink *out)
+{
+	this_session->mode = mode_number;
+	this_session->number_command = command;
+	this_session->number = 0;
+}
+
+static void do_rotate_right(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_rotate);
+
+	rotate_right(&(this_session->state.active_tetromino), &(this_session->state.main_matrix));
+	stop_latency(&(this_session->latency), latency_rotate, started);
+}
+
+static void do_rotate_left(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_rotate);
+
+	rotate_left(&(this_session->state.active_tetromino), &(this_session->state.main_matrix));
+	stop_latency(&(this_session->latency), latency_rotate, started);
+}
+
+static void do_right(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_nudge);
+
+	nudge_right(&(this_session->state.active_tetromino), &(this_session->state.main_matrix));
+	stop_latency(&(this_session->latency), latency_nudge, started);
+}
+
+static void do_left(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_nudge);
+
+	nudge_left(&(this_session->state.active_tetromino), &(this_session->state.main_matrix));
+	stop_latency(&(this_session->latency), latency_nudge, started);
+}
+
+static void do_down(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_nudge);
+
+	nudge_down(&(this_session->state.active_tetromino), &(this_session->state.main_matrix));
+	stop_latency(&(this_session->latency), latency_nudge, started);
+}
+
+static void do_drop(session *this_session, int command, output_sink *out)
+{
+	unsigned long long started = start_latency(&(this_session->latency), latency_drop);
+	tetromino *active_tetromino = &(this_session->state.active_tetromino);
+
+	active_tetromino->location.top += drop_distance(active_tetromino,
+		&(this_session->state.main_matrix));
+	history_lock(&(this_session->moves), &(this_session->state), &(this_session->game_is_over));
+	stop_latency(&(this_session->latency), latency_drop, started);
+}
+
+static void do_newline(session *this_session, int command, output_sink *out)
+{
+	write_output(out, "\n", 1);
+}
+
+static void do_query(session *this_session, int command, output_sink *out)
+{
+	this_session->mode = mode_query;
+}
+
+// the byte after '?', whitespace included
+static void query_command(session *this_session, int command, output_sink *out)
+{
+	switch (command)
+	{
+	case 's':
+		display_score(&(this_session->state), out);
+		break;
+	case 'n':
+		display_num_lines(&(this_session->state), out);
+		break;
+	case 'p':
+		display_placements(&(this_session->state), out);
+		break;
+	case 'g':
+		display_ghost(&(this_session->state), out);
+		break;
+	case 'e':
+		display_features(&(this_session->state), out);
+		break;
+	case 'l':
+		display_latency(&(this_session->latency), out);
+		break;
+	case 'r':
+		reset_latency(&(this_session->latency));
+		break;
+	case 'q':
+		display_preview(&(this_session->pieces), out);
+		break;
+	default:
+		unknown_command(command, out);
+		break;
+	}
+}
+
+static void menu_command(session *this_session, int command, output_sink *out)
+{
+	switch (command)
+	{
+	case '!':
+		this_session->mode = mode_play;
+		break;
+	default:
+		unknown_command(command, out);
+		break;
+	}
+}
+
+// Reads the digits after 'R' or '+', which end at the first byte that
+// isn't one. That byte is left to be read as a command.
+static const unsigned char *input_number(session *this_session,
+	const unsigned char *next, const unsigned char *end)
+{
+	piece_bag *pieces = &(this_session->pieces);
+
+	while (next < end && *next >= '0' && *next <= '9')
+	{
+		this_session->number = this_session->number * 10 + (*next++ - '0');
+	}
+
+	if (next == end)
+	{
+		return next;
+	}
+
+	if (this_session->number_command == 'R')
+	{
+		init_bag(pieces, seed_random(this_session->number, 0), pieces->preview);
+	}
+	else
+	{
+		set_preview(pieces, (this_session->number > BAG_MAX_PREVIEW)
+			? BAG_MAX_PREVIEW : (int)this_session->number);
+	}
+
+	this_session->mode = mode_play;
+	return next;
+}
+
+// Reads squares after 'g', in reading order, until the matrix is full
+// or the input runs out. The squares go straight into the color plane;
+// the occupancy of the rows written is rebuilt from it once at the end.
+static const unsigned char *input_squares(session *this_session,
+	const unsigned char *next, const unsigned char *end)
+{
+	matrix *this_matrix = &(this_session->state.main_matrix);
+	int square = this_session->next_square;
+	int first_row = square / MATRIX_WIDTH;
+
+	while (next < end && square < MATRIX_WIDTH * MATRIX_DEPTH)
+	{
+		int value = *next++;
+
+		if (is_blank(value))
+		{
+			continue;
+		}
+
+		if (!check_square_value(value))
+		{
+			value = empty;
+		}
+		this_matrix->squares[square++] = (char)value;
+	}
+
+	for (int row = first_row; row * MATRIX_WIDTH < square; row++)
+	{
+		const char *squares = this_matrix->squares + MATRIX_WIDTH * row;
+		row_bitfield bits = 0;
+
+		for (int col = 0; col < MATRIX_WIDTH; col++)
+		{
+			if (squares[col] != empty)
+			{
+				bits |= 1 << col;
+			}
+		}
+
+		set_row(this_matrix, row, bits);
+		if (bits != 0)
+		{
+			this_matrix->touched_rows |= 1u << row;
+		}
+	}
+
+	this_session->next_square = square;
+	if (square == MATRIX_WIDTH * MATRIX_DEPTH)
+	{
+		this_session->mode = mode_play;
+	}
+
+	return next;
+}
+
+void display_title(output_sink *out)
+{
+	write_text(out, "Learntris (c) 1992 Tetraminex, Inc.\n");
+}
+
+void game_over(output_sink *out)
+{
+	write_text(out, "Game Over\n");
+}
+
+void unknown_command(int command, output_sink *out)
+{
+	char text[] = "unknown command ?\n";
+
+	text[sizeof(text) - 3] = (char)command;
+	write_text(out, text);
+}
+
+void print_matrix(matrix *this_matrix, output_sink *out)
+{
+	char frame[FRAME_SIZE];
+
+	format_matrix(this_matrix, frame);
+	write_output(out, frame, FRAME_SIZE);
+}
+
+// fills exactly FRAME_SIZE bytes, in the same "%c " per square layout
+void format_matrix(matrix *this_matrix, char *frame)
+{
+	const char *square = this_matrix->squares;
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		for (int col = 0; col < MATRIX_WIDTH; col++)
+		{
+			*frame++ = *square++;
+			*frame++ = ' ';
+		}
+		*frame++ = '\n';
+	}
+}
+
+// writes the decimal digits of value, returns how many chars were written
+int format_int(char *buffer, int value)
+{
+	char digits[10];
+	int count = 0;
+	int length = 0;
+	unsigned int magnitude = (unsigned int)value;
+
+	if (value < 0)
+	{
+		buffer[length++] = '-';
+		magnitude = 0u - magnitude;
+	}
+
+	do
+	{
+		digits[count++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	while (count > 0)
+	{
+		buffer[length++] = digits[--count];
+	}
+
+	return length;
+}
+
+void display_score(game_state *this_game_state, output_sink *out)
+{
+	char text[16];
+	int length = format_int(text, this_game_state->score);
+
+	text[length++] = '\n';
+	write_output(out, text, length);
+}
+
+void display_num_lines(game_state *this_game_state, output_sink *out)
+{
+	char text[16];
+	int length = format_int(text, this_game_state->num_lines);
+
+	text[length++] = '\n';
+	write_output(out, text, length);
+}
+
+void display_tetromino(tetromino *this_tetromino, output_sink *out)
+{
+	int tetromino_height;
+	int tetromino_width;
+	const tetromino_pattern *cur_pattern;
+	char *pattern;
+	char text[TETROMINO_SIZE * (TETROMINO_SIZE * 2 + 1)];
+	char *cursor = text;
+
+	if (this_tetromino->type == illegal_tetromino
+		|| this_tetromino->position < 0)
+	{
+		return;
+	}
+
+	cur_pattern = tetromino_patterns + this_tetromino->type;
+	tetromino_height = cur_pattern->height;
+	tetromino_width = cur_pattern->width;
+	pattern = cur_pattern->pattern[this_tetromino->position];
+
+	for (int row = 0; row < tetromino_height; row++)
+	{
+		for (int col = 0; col < tetromino_width; col++)
+		{
+			*cursor++ = *pattern++;
+			*cursor++ = ' ';
+		}
+		*cursor++ = '\n';
+	}
+
+	write_output(out, text, cursor - text);
+}
+
+// paints the active tetromino in capitals onto a formatted frame
+void overlay_tetromino(char *frame, tetromino *this_tetromino)
+{
+	const tetromino_shape *shape;
+	char color;
+	int y, x;
+
+	if (this_tetromino->type == illegal_tetromino
+		|| this_tetromino->position < 0)
+	{
+		return;
+	}
+
+	shape = get_shape(this_tetromino);
+	color = toupper(tetromino_mask_table[this_tetromino->type].color);
+
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		for (int col = shape->left; col <= shape->right; col++)
+		{
+			y = this_tetromino->location.top + row;
+			x = this_tetromino->location.left + col;
+			if ((shape->rows[row] & (1 << col)) != 0
+				&& y >= 0 && y < MATRIX_DEPTH && x >= 0 && x < MATRIX_WIDTH)
+			{
+				frame[FRAME_ROW_SIZE * y + 2 * x] = color;
+			}
+		}
+	}
+}
+
+void print_all(game_state *this_game_state, output_sink *out)
+{
+	char frame[FRAME_SIZE];
+
+	format_matrix(&(this_game_state->main_matrix), frame);
+	overlay_tetromino(frame, &(this_game_state->active_tetromino));
+	write_output(out, frame, FRAME_SIZE);
+}
+
+// one "position top left" line per place the active tetromino can land
+void display_placements(game_state *this_game_state, output_sink *out)
+{
+	placement placements[MAX_PLACEMENTS];
+	char text[MAX_PLACEMENTS * 12];
+	char *cursor = text;
+	int count;
+
+	count = find_placements(&(this_game_state->main_matrix),
+		&(this_game_state->active_tetromino), placements);
+
+	for (int i = 0; i < count; i++)
+	{
+		cursor += format_int(cursor, placements[i].position);
+		*cursor++ = ' ';
+		cursor += format_int(cursor, placements[i].top);
+		*cursor++ = ' ';
+		cursor += format_int(cursor, placements[i].left);
+		*cursor++ = '\n';
+	}
+
+	write_output(out, text, cursor - text);
+}
+
+// where the active tetromino would land if dropped now, in the same
+// form as display_placements
+void display_ghost(game_state *this_game_state, output_sink *out)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+	char text[40];
+	char *cursor = text;
+
+	if (active_tetromino->type == illegal_tetromino)
+	{
+		return;
+	}
+
+	cursor += format_int(cursor, active_tetromino->position);
+	*cursor++ = ' ';
+	cursor += format_int(cursor, active_tetromino->location.top
+		+ drop_distance(active_tetromino, &(this_game_state->main_matrix)));
+	*cursor++ = ' ';
+	cursor += format_int(cursor, active_tetromino->location.left);
+	*cursor++ = '\n';
+
+	write_output(out, text, cursor - text);
+}
+
+// the board features of the matrix as it is, on one line in
+// board_feature_kinds order
+void display_features(game_state *this_game_state, output_sink *out)
+{
+	board_features features;
+	char text[feature_count * 12];
+	char *cursor = text;
+
+	compute_features(&(this_game_state->main_matrix), 0, &features);
+	for (int kind = 0; kind < feature_count; kind++)
+	{
+		cursor += format_int(cursor, features.values[kind]);
+		*cursor++ = (kind < feature_count - 1) ? ' ' : '\n';
+	}
+
+	write_output(out, text, cursor - text);
+}
+
+void display_latency(latency_stats *this_stats, output_sink *out)
+{
+	char text[latency_kinds_count * 96];
+
+	write_output(out, text, format_latency(this_stats, text));
+}
+
+// the pieces 'N' will spawn next, in order
+void display_preview(piece_bag *this_bag, output_sink *out)
+{
+	char text[BAG_MAX_PREVIEW * 2 + 1];
+	int length = 0;
+
+	for (int index = 0; index < this_bag->preview; index++)
+	{
+		text[length++] = spawn_commands[peek_piece(this_bag, index)];
+		text[length++] = ' ';
+	}
+
+	if (length > 0)
+	{
+		length--;
+	}
+	text[length++] = '\n';
+	write_output(out, text, length);
+}
@@ -0,0 +1,55 @@
+#ifndef LEARNTRIS_FRONTEND_H
+#define LEARNTRIS_FRONTEND_H
+
+#include "learntris.h"
+#include "history.h"
+#include "latency.h"
+#include "randomizer.h"
+#include "input.h"
+#include "output.h"
+
+// one frame is the matrix printed as "%c " per square, a row per line
+#define FRAME_ROW_SIZE (MATRIX_WIDTH * 2 + 1)
+#define FRAME_SIZE (MATRIX_DEPTH * FRAME_ROW_SIZE)
+
+// what the next byte of the text protocol means
+enum session_modes
+{
+	mode_play,
+	mode_query,		// after '?'
+	mode_paused,
+	mode_menu,		// after '@' then 'p'
+	mode_matrix,	// reading the squares after 'g'
+	mode_number,	// reading the digits after 'R' or '+'
+	mode_quit
+};
+
+// One game driven by the text protocol. Everything the protocol needs
+// between two bytes lives in here, so a game can be fed in chunks of
+// any size and any number of them can run side by side.
+typedef struct tag_session
+{
+	game_state state;
+	history moves;
+	int mode;
+	int next_square;		// in mode_matrix, squares read so far
+	int number_command;		// in mode_number, the 'R' or '+' being read
+	unsigned long number;	// and its digits so far
+	bool title_displayed;
+	bool game_is_over;
+	latency_stats latency;	// how long the commands took, for '?l'
+	piece_bag pieces;		// what 'N' spawns
+} session;
+
+// the text protocol, from frontend.cpp, for the tools that drive it
+// without a terminal
+void init_session(session *this_session);
+size_t feed_commands(session *this_session, const unsigned char *commands, size_t length,
+	output_sink *out);
+void game_loop(command_source *source, output_sink *out);
+void print_matrix(matrix *this_matrix, output_sink *out);
+void format_matrix(matrix *this_matrix, char *frame);
+void overlay_tetromino(char *frame, tetromino *this_tetromino);
+int format_int(char *buffer, int value);
+
+#endif
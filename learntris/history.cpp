@@ -0,0 +1,551 @@
+#include <string.h>
+#include "history.h"
+
+#define HISTORY_MASK (HISTORY_SIZE - 1)
+#define MAX_RECORD 255
+
+enum history_kinds
+{
+	record_lock,
+	record_step
+};
+
+// the flags byte of a record: whether the game was over before and
+// after it
+#define OVER_BEFORE 1
+#define OVER_AFTER 2
+
+static void save_piece(unsigned char *out, const tetromino *this_tetromino);
+static void load_piece(const unsigned char *in, tetromino *this_tetromino);
+static int piece_rows(const tetromino *this_tetromino, int *rows);
+static int piece_squares(const tetromino *this_tetromino, int *squares);
+static unsigned int full_rows_now(matrix *this_matrix);
+static void push_record(history *this_history, unsigned char *record, int length);
+static void read_record(history *this_history, unsigned int start, unsigned char *record, int length);
+static unsigned char over_flags(bool before, bool after);
+static void undo_lock(game_state *this_game_state, const unsigned char *record);
+static void undo_step(game_state *this_game_state, const unsigned char *record);
+
+void init_history(history *this_history)
+{
+	this_history->oldest = 0;
+	this_history->current = 0;
+	this_history->newest = 0;
+}
+
+// pieces are kept as four signed bytes: type, position, top, left
+static void save_piece(unsigned char *out, const tetromino *this_tetromino)
+{
+	out[0] = (unsigned char)(signed char)this_tetromino->type;
+	out[1] = (unsigned char)(signed char)this_tetromino->position;
+	out[2] = (unsigned char)(signed char)this_tetromino->location.top;
+	out[3] = (unsigned char)(signed char)this_tetromino->location.left;
+}
+
+static void load_piece(const unsigned char *in, tetromino *this_tetromino)
+{
+	this_tetromino->type = (signed char)in[0];
+	this_tetromino->position = (signed char)in[1];
+	this_tetromino->location.top = (signed char)in[2];
+	this_tetromino->location.left = (signed char)in[3];
+}
+
+// the matrix rows a piece covers, top to bottom
+static int piece_rows(const tetromino *this_tetromino, int *rows)
+{
+	const tetromino_shape *shape = get_shape((tetromino *)this_tetromino);
+	int count = 0;
+
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		int y = this_tetromino->location.top + row;
+
+		if (y >= 0 && y < MATRIX_DEPTH)
+		{
+			rows[count++] = y;
+		}
+	}
+
+	return count;
+}
+
+// the squares a piece paints, in the order paint_tetromino visits them
+static int piece_squares(const tetromino *this_tetromino, int *squares)
+{
+	const tetromino_shape *shape = get_shape((tetromino *)this_tetromino);
+	int top = this_tetromino->location.top;
+	int left = this_tetromino->location.left;
+	int count = 0;
+
+	for (int row = shape->top; row <= shape->bottom; row++)
+	{
+		for (int col = shape->left; col <= shape->right; col++)
+		{
+			if ((shape->rows[row] & (1 << col)) != 0
+				&& top + row >= 0 && top + row < MATRIX_DEPTH
+				&& left + col >= 0 && left + col < MATRIX_WIDTH)
+			{
+				squares[count++] = MATRIX_WIDTH * (top + row) + left + col;
+			}
+		}
+	}
+
+	return count;
+}
+
+// the rows exec_step is about to clear
+static unsigned int full_rows_now(matrix *this_matrix)
+{
+	unsigned int full_rows = 0;
+
+	for (unsigned int touched = this_matrix->touched_rows; touched != 0; touched &= touched - 1)
+	{
+		int row = lowest_bit(touched);
+
+		if (row_full(this_matrix, row))
+		{
+			full_rows |= 1u << row;
+		}
+	}
+
+	return full_rows;
+}
+
+// Drops whatever could still be redone, then makes room by dropping
+// the oldest records.
+static void push_record(history *this_history, unsigned char *record, int length)
+{
+	record[0] = (unsigned char)length;
+	record[length - 1] = (unsigned char)length;
+
+	this_history->newest = this_history->current;
+	while (this_history->newest + length - this_history->oldest > HISTORY_SIZE)
+	{
+		this_history->oldest += this_history->ring[this_history->oldest & HISTORY_MASK];
+	}
+
+	for (int i = 0; i < length; i++)
+	{
+		this_history->ring[(this_history->newest + i) & HISTORY_MASK] = record[i];
+	}
+	this_history->newest += length;
+	this_history->current = this_history->newest;
+}
+
+static void read_record(history *this_history, unsigned int start, unsigned char *record, int length)
+{
+	for (int i = 0; i < length; i++)
+	{
+		record[i] = this_history->ring[(start + i) & HISTORY_MASK];
+	}
+}
+
+static unsigned char over_flags(bool before, bool after)
+{
+	return (unsigned char)((before ? OVER_BEFORE : 0) | (after ? OVER_AFTER : 0));
+}
+
+// Locks the active tetromino, keeping the piece as it was, the rows it
+// lands on and the colors it paints over. Returns what lock_tetromino
+// returns, and sets game_is_over if that is false.
+bool history_lock(history *this_history, game_state *this_game_state, bool *game_is_over)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	unsigned char record[MAX_RECORD];
+	int rows[TETROMINO_SIZE];
+	int squares[TETROMINO_SIZE * TETROMINO_SIZE];
+	int length = 3;
+	int count;
+	bool alive;
+
+	if (active_tetromino->type == illegal_tetromino)
+	{
+		alive = lock_tetromino(this_game_state);
+		*game_is_over = *game_is_over || !alive;
+		return alive;
+	}
+
+	record[1] = record_lock;
+	save_piece(record + length, active_tetromino);
+	length += 4;
+	memcpy(record + length, &(this_matrix->touched_rows), sizeof(unsigned int));
+	length += sizeof(unsigned int);
+
+	count = piece_rows(active_tetromino, rows);
+	for (int i = 0; i < count; i++)
+	{
+		memcpy(record + length, this_matrix->rows + rows[i], sizeof(row_bitfield));
+		length += sizeof(row_bitfield);
+	}
+
+	count = piece_squares(active_tetromino, squares);
+	for (int i = 0; i < count; i++)
+	{
+		record[length++] = this_matrix->squares[squares[i]];
+	}
+
+	alive = lock_tetromino(this_game_state);
+	record[2] = over_flags(*game_is_over, *game_is_over || !alive);
+	*game_is_over = *game_is_over || !alive;
+	push_record(this_history, record, length + 1);
+	return alive;
+}
+
+// Steps, keeping which rows were cleared, their colors and the points
+// they were worth.
+void history_step(history *this_history, game_state *this_game_state, bool *game_is_over)
+{
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	unsigned char record[MAX_RECORD];
+	unsigned int full_rows = full_rows_now(this_matrix);
+	int score = this_game_state->score;
+	int num_lines = this_game_state->num_lines;
+	int length = 3;
+	int colors;
+
+	record[1] = record_step;
+	record[2] = over_flags(*game_is_over, *game_is_over);
+	memcpy(record + length, &full_rows, sizeof(unsigned int));
+	length += sizeof(unsigned int);
+	memcpy(record + length, &(this_matrix->touched_rows), sizeof(unsigned int));
+	length += sizeof(unsigned int);
+
+	// the points go in front of the colors once the step is done
+	colors = length + 2 * sizeof(int);
+	for (unsigned int full = full_rows; full != 0; full &= full - 1)
+	{
+		memcpy(record + colors, this_matrix->squares + MATRIX_WIDTH * lowest_bit(full),
+			MATRIX_WIDTH);
+		colors += MATRIX_WIDTH;
+	}
+
+	exec_step(this_game_state);
+
+	score = this_game_state->score - score;
+	num_lines = this_game_state->num_lines - num_lines;
+	memcpy(record + length, &score, sizeof(int));
+	memcpy(record + length + sizeof(int), &num_lines, sizeof(int));
+
+	push_record(this_history, record, colors + 1);
+}
+
+// play_placement followed by a step, recorded as two records so that
+// unmake_move can take both back. The active tetromino comes back where
+// it was locked, not where it was before. Nothing is recorded if there
+// is no active tetromino.
+bool make_move(history *this_history, game_state *this_game_state, const placement *target)
+{
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+	bool game_is_over = false;
+	bool alive;
+
+	if (active_tetromino->type == illegal_tetromino)
+	{
+		return false;
+	}
+
+	active_tetromino->position = target->position;
+	active_tetromino->location.top = target->top;
+	active_tetromino->location.left = target->left;
+
+	alive = history_lock(this_history, this_game_state, &game_is_over);
+	history_step(this_history, this_game_state, &game_is_over);
+	return alive;
+}
+
+void unmake_move(history *this_history, game_state *this_game_state)
+{
+	bool game_is_over = false;
+
+	undo(this_history, this_game_state, &game_is_over);
+	undo(this_history, this_game_state, &game_is_over);
+}
+
+static void undo_lock(game_state *this_game_state, const unsigned char *record)
+{
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	tetromino piece;
+	int rows[TETROMINO_SIZE];
+	int squares[TETROMINO_SIZE * TETROMINO_SIZE];
+	int count;
+
+	load_piece(record, &piece);
+	record += 4;
+	memcpy(&(this_matrix->touched_rows), record, sizeof(unsigned int));
+	record += sizeof(unsigned int);
+
+	count = piece_rows(&piece, rows);
+	for (int i = 0; i < count; i++)
+	{
+		row_bitfield bits;
+
+		memcpy(&bits, record, sizeof(row_bitfield));
+		record += sizeof(row_bitfield);
+		set_row(this_matrix, rows[i], bits);
+	}
+
+	count = piece_squares(&piece, squares);
+	for (int i = 0; i < count; i++)
+	{
+		this_matrix->squares[squares[i]] = *record++;
+	}
+
+	this_game_state->active_tetromino = piece;
+}
+
+// the reverse of collapse_rows: every row above a cleared one moves
+// back up, and the cleared rows come back full
+static void undo_step(game_state *this_game_state, const unsigned char *record)
+{
+	matrix *this_matrix = &(this_game_state->main_matrix);
+	unsigned int full_rows;
+	int score, num_lines;
+	int below;
+
+	memcpy(&full_rows, record, sizeof(unsigned int));
+	record += sizeof(unsigned int);
+	memcpy(&(this_matrix->touched_rows), record, sizeof(unsigned int));
+	record += sizeof(unsigned int);
+	memcpy(&score, record, sizeof(int));
+	memcpy(&num_lines, record + sizeof(int), sizeof(int));
+	record += 2 * sizeof(int);
+
+	this_game_state->score -= score;
+	this_game_state->num_lines -= num_lines;
+
+	if (full_rows == 0)
+	{
+		return;
+	}
+
+	// top down, a row comes back from as many rows lower as there
+	// are cleared rows under it
+	below = count_bits(full_rows);
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		if ((full_rows & (1u << row)) != 0)
+		{
+			this_matrix->rows[row] = FULL_ROW;
+			memcpy(this_matrix->squares + MATRIX_WIDTH * row, record, MATRIX_WIDTH);
+			record += MATRIX_WIDTH;
+			below--;
+		}
+		else if (below > 0)
+		{
+			this_matrix->rows[row] = this_matrix->rows[row + below];
+			memcpy(this_matrix->squares + MATRIX_WIDTH * row,
+				this_matrix->squares + MATRIX_WIDTH * (row + below), MATRIX_WIDTH);
+		}
+	}
+
+	// and the columns, bottom up, undoing what collapse_rows did
+	for (int row = MATRIX_DEPTH - 1; row >= 0; row--)
+	{
+		if ((full_rows & (1u << row)) != 0)
+		{
+			unsigned int above = (1u << row) - 1;
+
+			for (int col = 0; col < MATRIX_WIDTH; col++)
+			{
+				unsigned int bits = this_matrix->columns[col];
+
+				this_matrix->columns[col] = (bits & ~(above | (above + 1)))
+					| ((bits >> 1) & above) | (above + 1);
+			}
+		}
+	}
+}
+
+// Whether one record, read from outside, has every field in range and
+// the length its kind and payload call for.
+static bool valid_record(const unsigned char *record, int length)
+{
+	const unsigned char *payload = record + 3;
+	unsigned int touched;
+
+	if (length < 3 + 4 + (int)sizeof(unsigned int) + 1 || record[length - 1] != length
+		|| (record[2] & ~(OVER_BEFORE | OVER_AFTER)) != 0)
+	{
+		return false;
+	}
+
+	if (record[1] == record_lock)
+	{
+		tetromino piece;
+		int rows[TETROMINO_SIZE];
+		int squares[TETROMINO_SIZE * TETROMINO_SIZE];
+		int row_count, square_count;
+
+		load_piece(payload, &piece);
+		payload += 4;
+		memcpy(&touched, payload, sizeof(unsigned int));
+		payload += sizeof(unsigned int);
+		if (piece.type == illegal_tetromino || !valid_tetromino(&piece) || (touched & ~ALL_ROWS) != 0)
+		{
+			return false;
+		}
+
+		row_count = piece_rows(&piece, rows);
+		square_count = piece_squares(&piece, squares);
+		if (length != 3 + 4 + (int)sizeof(unsigned int)
+			+ row_count * (int)sizeof(row_bitfield) + square_count + 1)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < row_count; i++)
+		{
+			row_bitfield bits;
+
+			memcpy(&bits, payload, sizeof(row_bitfield));
+			payload += sizeof(row_bitfield);
+			if ((bits & ~FULL_ROW) != 0)
+			{
+				return false;
+			}
+		}
+		for (int i = 0; i < square_count; i++)
+		{
+			if (!check_square_value((char)*payload++))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	if (record[1] == record_step)
+	{
+		unsigned int full_rows;
+
+		if (length < 3 + 2 * (int)sizeof(unsigned int) + 2 * (int)sizeof(int) + 1)
+		{
+			return false;
+		}
+		memcpy(&full_rows, payload, sizeof(unsigned int));
+		memcpy(&touched, payload + sizeof(unsigned int), sizeof(unsigned int));
+		payload += 2 * sizeof(unsigned int) + 2 * sizeof(int);
+		if ((full_rows & ~ALL_ROWS) != 0 || (touched & ~ALL_ROWS) != 0
+			|| length != 3 + 2 * (int)sizeof(unsigned int) + 2 * (int)sizeof(int)
+				+ count_bits(full_rows) * MATRIX_WIDTH + 1)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < count_bits(full_rows) * MATRIX_WIDTH; i++)
+		{
+			if (!check_square_value((char)payload[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+
+// Whether the records between oldest and newest are ones undo and redo
+// can take, e.g. after reading the ring back from a file, with current
+// on a record boundary.
+bool history_valid(history *this_history)
+{
+	unsigned char record[MAX_RECORD];
+	bool current_found = false;
+	unsigned int start = this_history->oldest;
+
+	if (this_history->newest - this_history->oldest > HISTORY_SIZE)
+	{
+		return false;
+	}
+
+	while (start != this_history->newest)
+	{
+		int length = this_history->ring[start & HISTORY_MASK];
+
+		current_found = current_found || start == this_history->current;
+		if (length == 0 || this_history->newest - start < (unsigned int)length)
+		{
+			return false;
+		}
+
+		read_record(this_history, start, record, length);
+		if (!valid_record(record, length))
+		{
+			return false;
+		}
+		start += length;
+	}
+
+	return current_found || this_history->current == this_history->newest;
+}
+
+// Takes back the last lock or step; false if there is nothing left.
+// game_is_over goes back to what it was before the move, and what it is
+// now is kept in the record for redo, since a spawn after the move may
+// have ended the game without a record of its own.
+bool undo(history *this_history, game_state *this_game_state, bool *game_is_over)
+{
+	unsigned char record[MAX_RECORD];
+	unsigned char *flags;
+	int length;
+
+	if (this_history->current == this_history->oldest)
+	{
+		return false;
+	}
+
+	length = this_history->ring[(this_history->current - 1) & HISTORY_MASK];
+	this_history->current -= length;
+	read_record(this_history, this_history->current, record, length);
+
+	flags = this_history->ring + ((this_history->current + 2) & HISTORY_MASK);
+	*flags = over_flags((record[2] & OVER_BEFORE) != 0, *game_is_over);
+	*game_is_over = (record[2] & OVER_BEFORE) != 0;
+
+	if (record[1] == record_lock)
+	{
+		undo_lock(this_game_state, record + 3);
+	}
+	else
+	{
+		undo_step(this_game_state, record + 3);
+	}
+
+	return true;
+}
+
+// Does the last undone lock or step again, with game_is_over as it was
+// when it was undone; false if there is none.
+bool redo(history *this_history, game_state *this_game_state, bool *game_is_over)
+{
+	unsigned char record[MAX_RECORD];
+	unsigned char *flags;
+	int length;
+
+	if (this_history->current == this_history->newest)
+	{
+		return false;
+	}
+
+	length = this_history->ring[this_history->current & HISTORY_MASK];
+	read_record(this_history, this_history->current, record, length);
+
+	flags = this_history->ring + ((this_history->current + 2) & HISTORY_MASK);
+	*flags = over_flags(*game_is_over, (record[2] & OVER_AFTER) != 0);
+	*game_is_over = (record[2] & OVER_AFTER) != 0;
+	this_history->current += length;
+
+	if (record[1] == record_lock)
+	{
+		load_piece(record + 3, &(this_game_state->active_tetromino));
+		lock_tetromino(this_game_state);
+	}
+	else
+	{
+		exec_step(this_game_state);
+	}
+
+	return true;
+}
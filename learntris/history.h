@@ -0,0 +1,37 @@
+#ifndef LEARNTRIS_HISTORY_H
+#define LEARNTRIS_HISTORY_H
+
+#include "learntris.h"
+
+// bytes of history kept; must be a power of two. Once it fills up the
+// oldest records are dropped to make room.
+#define HISTORY_SIZE 4096
+
+// Undo/redo for the moves that change the matrix: locking a piece and
+// stepping. Every record only holds what that move changed, written
+// into a ring of bytes inside the struct, so recording never allocates.
+//
+// A record is laid out as
+//   length, kind, flags, payload..., length
+// so the ring can be walked both ways. oldest, current and newest are
+// byte counts that only ever grow, and are wrapped when indexing:
+// records between oldest and current can be undone, the ones between
+// current and newest can be redone.
+typedef struct tag_history
+{
+	unsigned char ring[HISTORY_SIZE];
+	unsigned int oldest;
+	unsigned int current;
+	unsigned int newest;
+} history;
+
+void init_history(history *this_history);
+bool history_lock(history *this_history, game_state *this_game_state, bool *game_is_over);
+void history_step(history *this_history, game_state *this_game_state, bool *game_is_over);
+bool make_move(history *this_history, game_state *this_game_state, const placement *target);
+void unmake_move(history *this_history, game_state *this_game_state);
+bool undo(history *this_history, game_state *this_game_state, bool *game_is_over);
+bool redo(history *this_history, game_state *this_game_state, bool *game_is_over);
+bool history_valid(history *this_history);
+
+#endif
@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <string.h>
+#include "input.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define BYTES(value) (0x0101010101010101ULL * (value))
+
+static unsigned long long blank_bytes(unsigned long long word);
+
+void init_stdin_source(command_source *this_source, unsigned char *block, size_t block_size)
+{
+	this_source->next = NULL;
+	this_source->end = NULL;
+	this_source->from_stdin = true;
+	this_source->block = block;
+	this_source->block_size = block_size;
+}
+
+void init_buffer_source(command_source *this_source, const char *data, size_t size)
+{
+	this_source->next = (const unsigned char *)data;
+	this_source->end = this_source->next + size;
+	this_source->from_stdin = false;
+	this_source->block = NULL;
+	this_source->block_size = 0;
+}
+
+// Reads the next block of stdin, which returns as soon as anything is
+// there, so a player typing a line at a time is answered a line at a
+// time. What has been printed is flushed first, since the player may be
+// waiting on it before typing more. False at the end of the input.
+bool refill_source(command_source *this_source)
+{
+	long length;
+
+	if (!this_source->from_stdin)
+	{
+		return false;
+	}
+
+	fflush(stdout);
+#ifdef _WIN32
+	length = _read(0, this_source->block, (unsigned int)this_source->block_size);
+#else
+	do
+	{
+		length = (long)read(0, this_source->block, this_source->block_size);
+	} while (length < 0 && errno == EINTR);
+#endif
+
+	if (length <= 0)
+	{
+		return false;
+	}
+
+	this_source->next = this_source->block;
+	this_source->end = this_source->block + length;
+	return true;
+}
+
+// the top bit of every byte of word that is_blank, the others clear;
+// no carry ever crosses from one byte into the next
+static unsigned long long blank_bytes(unsigned long long word)
+{
+	unsigned long long low = word & BYTES(0x7F);
+	unsigned long long spaces = word ^ BYTES(' ');
+	unsigned long long controls = (low + BYTES(0x80 - '\t')) & ~(low + BYTES(0x80 - '\r' - 1)) & ~word;
+	unsigned long long is_space = ~(((spaces & BYTES(0x7F)) + BYTES(0x7F)) | spaces);
+	unsigned long long is_zero = ~((low + BYTES(0x7F)) | word);
+
+	return (controls | is_space | is_zero) & BYTES(0x80);
+}
+
+// the first byte at or after next that isn't blank, or end; whole
+// words of blanks are stepped over eight bytes at a time
+const unsigned char *skip_blanks(const unsigned char *next, const unsigned char *end)
+{
+	if (next == end || !is_blank(*next))
+	{
+		return next;
+	}
+
+	while (end - next >= 8)
+	{
+		unsigned long long word;
+
+		memcpy(&word, next, sizeof(word));
+		if (blank_bytes(word) != BYTES(0x80))
+		{
+			break;
+		}
+		next += 8;
+	}
+
+	while (next < end && is_blank(*next))
+	{
+		next++;
+	}
+
+	return next;
+}
+
+#ifdef _WIN32
+
+bool map_file(const char *path, mapped_file *this_file)
+{
+	LARGE_INTEGER size;
+
+	this_file->data = NULL;
+	this_file->size = 0;
+	this_file->mapping = NULL;
+
+	this_file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (this_file->file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (!GetFileSizeEx(this_file->file, &size))
+	{
+		unmap_file(this_file);
+		return false;
+	}
+
+	// an empty file cannot be mapped, but it is a valid (empty) script
+	if (size.QuadPart == 0)
+	{
+		return true;
+	}
+
+	this_file->mapping = CreateFileMapping(this_file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (this_file->mapping == NULL)
+	{
+		unmap_file(this_file);
+		return false;
+	}
+
+	this_file->data = (const char *)MapViewOfFile(this_file->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (this_file->data == NULL)
+	{
+		unmap_file(this_file);
+		return false;
+	}
+
+	this_file->size = (size_t)size.QuadPart;
+	return true;
+}
+
+void unmap_file(mapped_file *this_file)
+{
+	if (this_file->data != NULL)
+	{
+		UnmapViewOfFile(this_file->data);
+	}
+	if (this_file->mapping != NULL)
+	{
+		CloseHandle(this_file->mapping);
+	}
+	if (this_file->file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(this_file->file);
+	}
+
+	this_file->data = NULL;
+	this_file->size = 0;
+	this_file->mapping = NULL;
+	this_file->file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool map_file(const char *path, mapped_file *this_file)
+{
+	struct stat info;
+	void *data;
+
+	this_file->data = NULL;
+	this_file->size = 0;
+
+	this_file->fd = open(path, O_RDONLY);
+	if (this_file->fd < 0)
+	{
+		return false;
+	}
+
+	if (fstat(this_file->fd, &info) != 0)
+	{
+		unmap_file(this_file);
+		return false;
+	}
+
+	// an empty file cannot be mapped, but it is a valid (empty) script
+	if (info.st_size == 0)
+	{
+		return true;
+	}
+
+	data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, this_file->fd, 0);
+	if (data == MAP_FAILED)
+	{
+		unmap_file(this_file);
+		return false;
+	}
+
+	madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+	this_file->data = (const char *)data;
+	this_file->size = (size_t)info.st_size;
+	return true;
+}
+
+void unmap_file(mapped_file *this_file)
+{
+	if (this_file->data != NULL)
+	{
+		munmap((void *)this_file->data, this_file->size);
+	}
+	if (this_file->fd >= 0)
+	{
+		close(this_file->fd);
+	}
+
+	this_file->data = NULL;
+	this_file->size = 0;
+	this_file->fd = -1;
+}
+
+#endif
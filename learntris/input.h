@@ -0,0 +1,62 @@
+#ifndef LEARNTRIS_INPUT_H
+#define LEARNTRIS_INPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// stdin is read this much at a time
+#define INPUT_BLOCK_SIZE 65536
+
+// Where game_loop gets its commands from: either a block of memory
+// (a mapped script file), or stdin read a block at a time into the
+// caller's buffer.
+typedef struct tag_command_source
+{
+	const unsigned char *next;
+	const unsigned char *end;
+	bool from_stdin;
+	unsigned char *block;
+	size_t block_size;
+} command_source;
+
+typedef struct tag_mapped_file
+{
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+} mapped_file;
+
+void init_stdin_source(command_source *this_source, unsigned char *block, size_t block_size);
+void init_buffer_source(command_source *this_source, const char *data, size_t size);
+bool refill_source(command_source *this_source);
+const unsigned char *skip_blanks(const unsigned char *next, const unsigned char *end);
+bool map_file(const char *path, mapped_file *this_file);
+void unmap_file(mapped_file *this_file);
+
+// the bytes the protocol ignores between commands
+inline bool is_blank(int value)
+{
+	return value == ' ' || (value >= '\t' && value <= '\r') || value == '\0';
+}
+
+// returns EOF when there is nothing left to read
+inline int next_command(command_source *this_source)
+{
+	if (this_source->next < this_source->end || refill_source(this_source))
+	{
+		return *this_source->next++;
+	}
+
+	return EOF;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "latency.h"
+
+static const char *latency_names[latency_kinds_count] =
+{
+	"spawn", "nudge", "rotate", "drop", "step", "print"
+};
+
+static unsigned long long bucket_limit(int bucket);
+static int format_count(char *buffer, unsigned long long value);
+
+void reset_latency(latency_stats *this_stats)
+{
+	memset(this_stats, 0, sizeof(latency_stats));
+}
+
+// the largest time that lands in bucket
+static unsigned long long bucket_limit(int bucket)
+{
+	int group;
+
+	bucket++;
+	if (bucket < (1 << (LATENCY_SUB_BITS + 1)))
+	{
+		return bucket - 1;
+	}
+
+	group = (bucket >> LATENCY_SUB_BITS) - 1;
+	return ((unsigned long long)((1 << LATENCY_SUB_BITS) + (bucket & ((1 << LATENCY_SUB_BITS) - 1)))
+		<< group) - 1;
+}
+
+// format_int for counts and times that may not fit an int
+static int format_count(char *buffer, unsigned long long value)
+{
+	char digits[20];
+	int count = 0;
+	int length = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	while (count > 0)
+	{
+		buffer[length++] = digits[--count];
+	}
+
+	return length;
+}
+
+// the time under which fraction of the commands finished, rounded up
+// to the end of its bucket; 0 if none were timed
+unsigned long long latency_percentile(const latency_histogram *histogram, double fraction)
+{
+	unsigned long long rank = (unsigned long long)(fraction * (double)histogram->timed);
+	unsigned long long seen = 0;
+
+	if (histogram->timed == 0)
+	{
+		return 0;
+	}
+
+	if ((double)rank < fraction * (double)histogram->timed)
+	{
+		rank++;
+	}
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+
+	for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+	{
+		seen += histogram->buckets[bucket];
+		if (seen >= rank)
+		{
+			return bucket_limit(bucket);
+		}
+	}
+
+	return bucket_limit(LATENCY_BUCKETS - 1);
+}
+
+// what '?l' prints: a line per kind of command with how many there
+// were and the 50th, 99th and 99.9th percentile times in nanoseconds
+// of the ones timed
+int format_latency(latency_stats *this_stats, char *text)
+{
+	static const double fractions[] = { 0.5, 0.99, 0.999 };
+	char *cursor = text;
+
+	for (int kind = 0; kind < latency_kinds_count; kind++)
+	{
+		const latency_histogram *histogram = this_stats->kinds + kind;
+		size_t length = strlen(latency_names[kind]);
+
+		memcpy(cursor, latency_names[kind], length);
+		cursor += length;
+		*cursor++ = ' ';
+		cursor += format_count(cursor, histogram->count);
+
+		for (int i = 0; i < 3; i++)
+		{
+			*cursor++ = ' ';
+			cursor += format_count(cursor, latency_percentile(histogram, fractions[i]));
+		}
+		*cursor++ = '\n';
+	}
+
+	return (int)(cursor - text);
+}
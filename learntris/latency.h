@@ -0,0 +1,97 @@
+#ifndef LEARNTRIS_LATENCY_H
+#define LEARNTRIS_LATENCY_H
+
+#include "platform.h"
+
+// Exact below 8 ns, then four buckets per power of two, so any time is
+// at most 25% off; the last bucket takes everything from 2^39 ns (about
+// nine minutes) up.
+#define LATENCY_SUB_BITS 2
+#define LATENCY_BUCKETS 156
+
+// Every command is counted, but reading the clock costs more than most
+// commands, so only the first of every LATENCY_SAMPLE of each kind is
+// timed. Must be a power of two.
+#define LATENCY_SAMPLE 16
+
+// the commands that are timed, in the order '?l' lists them
+enum latency_kinds
+{
+	latency_spawn,
+	latency_nudge,
+	latency_rotate,
+	latency_drop,
+	latency_step,
+	latency_print,
+	latency_kinds_count
+};
+
+typedef struct tag_latency_histogram
+{
+	unsigned long long count;	// commands run
+	unsigned long long timed;	// of those, the ones in the buckets
+	unsigned long long buckets[LATENCY_BUCKETS];
+} latency_histogram;
+
+typedef struct tag_latency_stats
+{
+	latency_histogram kinds[latency_kinds_count];
+} latency_stats;
+
+void reset_latency(latency_stats *this_stats);
+unsigned long long latency_percentile(const latency_histogram *histogram, double fraction);
+int format_latency(latency_stats *this_stats, char *text);
+
+inline int latency_bucket(unsigned long long nanoseconds)
+{
+	int top = 0;
+	int bucket;
+
+	if (nanoseconds < (1u << (LATENCY_SUB_BITS + 1)))
+	{
+		return (int)nanoseconds;
+	}
+
+#if defined(__GNUC__)
+	top = 63 - __builtin_clzll(nanoseconds);
+#else
+	for (unsigned long long bits = nanoseconds >> 1; bits != 0; bits >>= 1)
+	{
+		top++;
+	}
+#endif
+
+	bucket = ((top - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+		+ (int)((nanoseconds >> (top - LATENCY_SUB_BITS)) & ((1u << LATENCY_SUB_BITS) - 1));
+	return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+inline void record_latency(latency_stats *this_stats, int kind, unsigned long long nanoseconds)
+{
+	latency_histogram *histogram = this_stats->kinds + kind;
+
+	histogram->timed++;
+	histogram->buckets[latency_bucket(nanoseconds)]++;
+}
+
+// Counts a command that is about to run. Returns when it started if it
+// is one to time, 0 if not.
+inline unsigned long long start_latency(latency_stats *this_stats, int kind)
+{
+	if ((this_stats->kinds[kind].count++ & (LATENCY_SAMPLE - 1)) != 0)
+	{
+		return 0;
+	}
+
+	return nanoseconds_now();
+}
+
+inline void stop_latency(latency_stats *this_stats, int kind, unsigned long long started)
+{
+	if (started != 0)
+	{
+		record_latency(this_stats, kind, nanoseconds_now() - started);
+	}
+}
+
+#endif
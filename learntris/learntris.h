@@ -0,0 +1,203 @@
+#ifndef LEARNTRIS_H
+#define LEARNTRIS_H
+
+#define MATRIX_WIDTH 10
+#define MATRIX_DEPTH 22
+#define TETROMINO_POSITIONS 4
+#define TETROMINO_SIZE 4
+#define FULL_ROW ((row_bitfield)((1 << MATRIX_WIDTH) - 1))
+#define MAX_PLACEMENTS (TETROMINO_POSITIONS * MATRIX_DEPTH * MATRIX_WIDTH)
+#define ALL_ROWS ((1u << MATRIX_DEPTH) - 1)
+#define SRS_KICKS 5
+
+enum tetromino_types
+{
+	tetromino_I,
+	tetromino_J,
+	tetromino_L,
+	tetromino_O,
+	tetromino_S,
+	tetromino_T,
+	tetromino_Z,
+	illegal_tetromino = -1
+};
+
+enum square_state 
+{
+	empty = '.',
+	red = 'r',
+	green = 'g',
+	blue = 'b',
+	orange = 'o',
+	cyan = 'c',
+	magenta = 'm',
+	yellow = 'y'
+};
+
+typedef struct tag_tetromino_pattern
+{
+	char *pattern[TETROMINO_POSITIONS];
+	int width;
+	int height;
+} tetromino_pattern;
+
+extern const tetromino_pattern tetromino_patterns[];
+
+// one bit per column, bit 0 is the leftmost column
+typedef unsigned short row_bitfield;
+
+// One rotation of a tetromino, precomputed from tetromino_patterns
+// so that the movement code never has to look at the strings.
+// top/bottom/left/right is the bounding box of the filled squares
+// inside the pattern.
+typedef struct tag_tetromino_shape
+{
+	row_bitfield rows[TETROMINO_SIZE];		// bit per column, for each row
+	unsigned char columns[TETROMINO_SIZE];	// bit per row, for each column
+	int top;
+	int bottom;
+	int left;
+	int right;
+} tetromino_shape;
+
+typedef struct tag_tetromino_masks
+{
+	tetromino_shape shapes[TETROMINO_POSITIONS];
+	int spawn_left;
+	char color;
+} tetromino_masks;
+
+extern const tetromino_masks tetromino_mask_table[];
+
+typedef struct tag_tetromino_location
+{
+	int top;
+	int left;
+} tetromino_location;
+
+typedef struct tag_tetromino
+{
+	int type;
+	int position;
+	tetromino_location location;
+} tetromino;
+
+typedef struct tag_matrix
+{
+	// occupancy, used by all the game rules
+	row_bitfield rows[MATRIX_DEPTH];
+	// colors, only read when rendering
+	char squares[MATRIX_WIDTH * MATRIX_DEPTH + 1];
+	// the same occupancy by column, bit per row: the surface of a
+	// column is its lowest set bit and the holes are the gaps below it
+	unsigned int columns[MATRIX_WIDTH];
+	// bit per row that may have filled up since the last step; code
+	// that writes rows directly has to call sync_matrix afterwards
+	unsigned int touched_rows;
+} matrix;
+
+// one wall kick: how far a rotation may move the piece to make it fit
+typedef struct tag_kick_offset
+{
+	int top;
+	int left;
+} kick_offset;
+
+// where a piece comes to rest: its rotation and the location of
+// its pattern box
+typedef struct tag_placement
+{
+	int position;
+	int top;
+	int left;
+} placement;
+
+typedef struct tag_game_state
+{
+	matrix main_matrix;
+	tetromino active_tetromino;
+	int score;
+	int num_lines;
+} game_state;
+
+void init(game_state *this_game_state);
+void clear_row(matrix *this_matrix, int row);
+void set_row(matrix *this_matrix, int row, row_bitfield bits);
+void clear_matrix(matrix *this_matrix);
+bool check_square_value(char value);
+bool row_full(matrix *this_matrix, int row);
+void exec_step(game_state *this_game_state);
+void collapse_rows(matrix *this_matrix, unsigned int full_rows);
+bool insert_garbage(matrix *this_matrix, int count, int hole, char color);
+void sync_matrix(matrix *this_matrix);
+int column_height(matrix *this_matrix, int col);
+bool spawn_tetromino(tetromino *this_tetromino, int tetromino_type, matrix *this_matrix);
+bool rotate_right(tetromino *this_tetromino, matrix *this_matrix);
+bool rotate_left(tetromino *this_tetromino, matrix *this_matrix);
+const kick_offset *get_kicks(int tetromino_type, int position, int turn);
+bool check_collision_right(tetromino *this_tetromino, matrix *this_matrix);
+bool check_collision_left(tetromino *this_tetromino, matrix *this_matrix);
+bool check_collision_down(tetromino *this_tetromino, matrix *this_matrix);
+bool nudge_right(tetromino *this_tetromino, matrix *this_matrix);
+bool nudge_left(tetromino *this_tetromino, matrix *this_matrix);
+bool nudge_down(tetromino *this_tetromino, matrix *this_matrix);
+const tetromino_shape *get_shape(tetromino *this_tetromino);
+bool valid_tetromino(tetromino *this_tetromino);
+row_bitfield shift_row(row_bitfield bits, int left);
+bool check_overlap(tetromino *this_tetromino, matrix *this_matrix, int row_offset, int col_offset);
+void paint_tetromino(matrix *this_matrix, tetromino *this_tetromino, char color);
+void insert_tetromino(matrix *this_matrix, tetromino *new_tetromino);
+int drop_distance(tetromino *this_tetromino, matrix *this_matrix);
+bool drop_tetromino(game_state *this_game_state);
+bool lock_tetromino(game_state *this_game_state);
+bool play_placement(game_state *this_game_state, const placement *target);
+int find_placements(matrix *this_matrix, tetromino *this_tetromino, placement *placements);
+
+inline int count_bits(unsigned int bits)
+{
+#if defined(__GNUC__)
+	return __builtin_popcount(bits);
+#else
+	int count = 0;
+
+	for (; bits != 0; bits &= bits - 1)
+	{
+		count++;
+	}
+	return count;
+#endif
+}
+
+// index of the lowest set bit, bits must not be 0
+inline int lowest_bit(unsigned int bits)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(bits);
+#else
+	int index = 0;
+
+	for (; (bits & 1) == 0; bits >>= 1)
+	{
+		index++;
+	}
+	return index;
+#endif
+}
+
+// index of the highest set bit, bits must not be 0
+inline int highest_bit(unsigned int bits)
+{
+#if defined(__GNUC__)
+	return 31 - __builtin_clz(bits);
+#else
+	int index = 0;
+
+	for (bits >>= 1; bits != 0; bits >>= 1)
+	{
+		index++;
+	}
+	return index;
+#endif
+}
+
+#endif
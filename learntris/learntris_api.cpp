@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include "learntris_api.h"
+#include "frontend.h"
+#include "evaluator.h"
+
+// the public header can't include learntris.h, so it repeats the sizes
+typedef char width_matches[(LEARNTRIS_WIDTH == MATRIX_WIDTH) ? 1 : -1];
+typedef char depth_matches[(LEARNTRIS_DEPTH == MATRIX_DEPTH) ? 1 : -1];
+
+struct learntris_game
+{
+	session game;
+	output_sink out;	// in memory, drained by learntris_read_output
+};
+
+int learntris_api_version(void)
+{
+	return LEARNTRIS_API_VERSION;
+}
+
+learntris_game *learntris_create(void)
+{
+	learntris_game *game = (learntris_game *)malloc(sizeof(learntris_game));
+
+	if (game == NULL)
+	{
+		return NULL;
+	}
+
+	init_session(&(game->game));
+	init_memory_output(&(game->out));
+	return game;
+}
+
+void learntris_destroy(learntris_game *game)
+{
+	if (game == NULL)
+	{
+		return;
+	}
+
+	free_output(&(game->out));
+	free(game);
+}
+
+// a new game; output not yet read is dropped
+void learntris_reset(learntris_game *game)
+{
+	init_session(&(game->game));
+	game->out.size = 0;
+}
+
+size_t learntris_command(learntris_game *game, const char *commands, size_t length)
+{
+	return feed_commands(&(game->game), (const unsigned char *)commands, length, &(game->out));
+}
+
+int learntris_step(learntris_game *game)
+{
+	int num_lines = game->game.state.num_lines;
+
+	history_step(&(game->game.moves), &(game->game.state), &(game->game.game_is_over));
+	return game->game.state.num_lines - num_lines;
+}
+
+void learntris_seed(learntris_game *game, unsigned long seed, int preview)
+{
+	init_bag(&(game->game.pieces), seed_random(seed, 0), preview);
+}
+
+int learntris_spawn_next(learntris_game *game)
+{
+	session *this_session = &(game->game);
+
+	if (!spawn_tetromino(&(this_session->state.active_tetromino), next_piece(&(this_session->pieces)),
+		&(this_session->state.main_matrix)))
+	{
+		this_session->game_is_over = true;
+		return 0;
+	}
+
+	return 1;
+}
+
+int learntris_preview(learntris_game *game, int *pieces, int size)
+{
+	piece_bag *this_bag = &(game->game.pieces);
+	int count = (size < this_bag->preview) ? size : this_bag->preview;
+
+	for (int index = 0; index < count; index++)
+	{
+		pieces[index] = peek_piece(this_bag, index);
+	}
+
+	return count;
+}
+
+int learntris_query(learntris_game *game, int query)
+{
+	game_state *this_game_state = &(game->game.state);
+	tetromino *active_tetromino = &(this_game_state->active_tetromino);
+
+	switch (query)
+	{
+	case LEARNTRIS_SCORE:
+		return this_game_state->score;
+	case LEARNTRIS_LINES:
+		return this_game_state->num_lines;
+	case LEARNTRIS_GAME_OVER:
+		return game->game.game_is_over ? 1 : 0;
+	case LEARNTRIS_QUIT:
+		return (game->game.mode == mode_quit) ? 1 : 0;
+	case LEARNTRIS_PIECE:
+		return active_tetromino->type;
+	case LEARNTRIS_POSITION:
+		return active_tetromino->position;
+	case LEARNTRIS_TOP:
+		return active_tetromino->location.top;
+	case LEARNTRIS_LEFT:
+		return active_tetromino->location.left;
+	default:
+		return -1;
+	}
+}
+
+int learntris_features(learntris_game *game, int *features, int size)
+{
+	board_features values;
+	int count = (size < feature_count) ? size : feature_count;
+
+	compute_features(&(game->game.state.main_matrix), 0, &values);
+	for (int kind = 0; kind < count; kind++)
+	{
+		features[kind] = values.values[kind];
+	}
+
+	return count;
+}
+
+size_t learntris_render(learntris_game *game, char *buffer, size_t size)
+{
+	if (size >= FRAME_SIZE)
+	{
+		format_matrix(&(game->game.state.main_matrix), buffer);
+		overlay_tetromino(buffer, &(game->game.state.active_tetromino));
+	}
+
+	return FRAME_SIZE;
+}
+
+size_t learntris_read_output(learntris_game *game, char *buffer, size_t size)
+{
+	output_sink *out = &(game->out);
+
+	if (size > out->size)
+	{
+		size = out->size;
+	}
+
+	if (size > 0)
+	{
+		memcpy(buffer, out->data, size);
+		memmove(out->data, out->data + size, out->size - size);
+		out->size -= size;
+	}
+
+	return size;
+}
@@ -0,0 +1,106 @@
+#ifndef LEARNTRIS_API_H
+#define LEARNTRIS_API_H
+
+#include <stddef.h>
+
+// The engine as a library, for programs that run many games in one
+// process. Plain C, so it can be called from C, C++ or anything with a
+// C FFI. Every game is its own object: nothing is shared between games
+// and nothing is written to stdout, so separate games can be driven
+// from separate threads without locking. One game must not be used
+// from two threads at once.
+//
+// Build with learntris_api.cpp, frontend.cpp, engine.cpp,
+// placement.cpp, history.cpp, evaluator.cpp, randomizer.cpp, input.cpp,
+// output.cpp, latency.cpp and platform.cpp, and probe.cpp as well if
+// LEARNTRIS_PROBES is defined. Nothing else in learntris/ is needed.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bumped whenever a declaration below changes
+#define LEARNTRIS_API_VERSION 3
+
+#define LEARNTRIS_WIDTH 10
+#define LEARNTRIS_DEPTH 22
+// what learntris_render writes: "%c " per square, a newline per row
+#define LEARNTRIS_FRAME_SIZE (LEARNTRIS_DEPTH * (LEARNTRIS_WIDTH * 2 + 1))
+
+typedef struct learntris_game learntris_game;
+
+enum learntris_queries
+{
+	LEARNTRIS_SCORE,
+	LEARNTRIS_LINES,
+	LEARNTRIS_GAME_OVER,	// 1 once a tetromino couldn't spawn or lock
+	LEARNTRIS_QUIT,			// 1 once a 'q' has been read
+	LEARNTRIS_PIECE,		// the active tetromino, 0-6 for IJLOSTZ, or -1
+	LEARNTRIS_POSITION,		// its rotation
+	LEARNTRIS_TOP,			// the row of its pattern box
+	LEARNTRIS_LEFT			// the column of its pattern box
+};
+
+// what learntris_features copies, in the order '?e' prints them
+enum learntris_features
+{
+	LEARNTRIS_HEIGHT,				// sum of the column heights
+	LEARNTRIS_HOLES,				// empty squares under the surface
+	LEARNTRIS_BUMPINESS,			// sum of height differences between neighbours
+	LEARNTRIS_ROW_TRANSITIONS,		// filled/empty changes along the rows
+	LEARNTRIS_COLUMN_TRANSITIONS,	// filled/empty changes down the columns
+	LEARNTRIS_WELLS,				// sum of how far columns are below both neighbours
+	LEARNTRIS_CLEARED,				// full rows the next step will clear
+	LEARNTRIS_FEATURE_COUNT
+};
+
+int learntris_api_version(void);
+
+// NULL if out of memory
+learntris_game *learntris_create(void);
+void learntris_destroy(learntris_game *game);
+void learntris_reset(learntris_game *game);
+
+// Feeds text protocol commands, exactly as the command line program
+// reads them from stdin; a command may be split across calls. Returns
+// how many bytes were used, which is less than length only when a 'q'
+// was read.
+size_t learntris_command(learntris_game *game, const char *commands, size_t length);
+
+// the same as the 's' command; returns the lines it cleared
+int learntris_step(learntris_game *game);
+
+// Restarts the piece sequence 'N' spawns from seed, the same as the
+// 'R' command, and shows preview pieces of it (0 to 16), as '+' does.
+// A game starts out with seed 0 and a preview of 5.
+void learntris_seed(learntris_game *game, unsigned long seed, int preview);
+
+// the same as the 'N' command; returns 0 if the piece couldn't spawn,
+// which ends the game
+int learntris_spawn_next(learntris_game *game);
+
+// Copies up to size of the pieces coming after the active one, 0-6 for
+// IJLOSTZ, and returns how many it copied.
+int learntris_preview(learntris_game *game, int *pieces, int size);
+
+// one of learntris_queries, -1 for anything else
+int learntris_query(learntris_game *game, int query);
+
+// Copies up to size of the board features, as '?e' prints them, and
+// returns how many it copied.
+int learntris_features(learntris_game *game, int *features, int size);
+
+// Writes the matrix with the active tetromino in capitals, the frame
+// the 'P' command prints, without a terminating NUL. Returns
+// LEARNTRIS_FRAME_SIZE, and writes nothing if size is smaller.
+size_t learntris_render(learntris_game *game, char *buffer, size_t size);
+
+// Takes up to size bytes of what the commands have printed so far.
+// Returns how many were copied; the rest stay for the next call.
+size_t learntris_read_output(learntris_game *game, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
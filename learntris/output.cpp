@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+
+void init_file_output(output_sink *this_output, FILE *file)
+{
+	this_output->file = file;
+	this_output->data = NULL;
+	this_output->size = 0;
+	this_output->capacity = 0;
+}
+
+void init_memory_output(output_sink *this_output)
+{
+	init_file_output(this_output, NULL);
+}
+
+void free_output(output_sink *this_output)
+{
+	free(this_output->data);
+	this_output->data = NULL;
+	this_output->size = 0;
+	this_output->capacity = 0;
+}
+
+// in memory, output that doesn't fit once the allocation fails is lost
+void write_output(output_sink *this_output, const char *text, size_t length)
+{
+	if (this_output->file != NULL)
+	{
+		fwrite(text, 1, length, this_output->file);
+		return;
+	}
+
+	if (this_output->size + length > this_output->capacity)
+	{
+		size_t capacity = (this_output->capacity == 0) ? 4096 : this_output->capacity * 2;
+		char *data;
+
+		while (capacity < this_output->size + length)
+		{
+			capacity *= 2;
+		}
+
+		data = (char *)realloc(this_output->data, capacity);
+		if (data == NULL)
+		{
+			return;
+		}
+		this_output->data = data;
+		this_output->capacity = capacity;
+	}
+
+	memcpy(this_output->data + this_output->size, text, length);
+	this_output->size += length;
+}
+
+void write_text(output_sink *this_output, const char *text)
+{
+	write_output(this_output, text, strlen(text));
+}
@@ -0,0 +1,24 @@
+#ifndef LEARNTRIS_OUTPUT_H
+#define LEARNTRIS_OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Where game_loop's output goes: straight to a FILE, or, when file is
+// NULL, into a block of memory that grows as needed. Each game_loop
+// gets its own, so several can run side by side.
+typedef struct tag_output_sink
+{
+	FILE *file;
+	char *data;
+	size_t size;
+	size_t capacity;
+} output_sink;
+
+void init_file_output(output_sink *this_output, FILE *file);
+void init_memory_output(output_sink *this_output);
+void free_output(output_sink *this_output);
+void write_output(output_sink *this_output, const char *text, size_t length);
+void write_text(output_sink *this_output, const char *text);
+
+#endif
@@ -0,0 +1,279 @@
+#include "learntris.h"
+#include "probe.h"
+
+// Placement enumeration works on whole rows of candidate locations at
+// once. For every rotation and pattern box top, legal[position][top]
+// has bit x set when the piece fits with its bounding box starting at
+// column x. Reachability is then flooded through those masks: sideways
+// within a row, through rotations, and down to the next row, so no
+// single nudge is ever simulated and the matrix is never copied.
+//
+// A rotation tries the SRS kicks in order and takes the first that fits,
+// which is one mask per kick for the whole row: the locations the first
+// kick places are taken out before the second is tried, and so on. Kicks
+// can move the piece up as well as down, so a row gets flooded again
+// whenever a kick from below adds to it.
+
+typedef unsigned int location_bits;
+
+// Pattern box tops go down to -TOP_MARGIN, as the flat I has two blank
+// rows over it; the arrays below are indexed by top + TOP_MARGIN.
+#define TOP_MARGIN 2
+#define PLACEMENT_ROWS (MATRIX_DEPTH + TOP_MARGIN)
+
+static row_bitfield normalized_row(const tetromino_shape *shape, int row);
+static int canonical_position(const tetromino_masks *masks, int position);
+static location_bits legal_locations(matrix *this_matrix, const tetromino_shape *shape, int top);
+static location_bits shift_locations(location_bits bits, int offset);
+static location_bits spread_sideways(location_bits reach, location_bits legal);
+static unsigned int flood_row(int type, const tetromino_masks *masks,
+	location_bits legal[][PLACEMENT_ROWS + 1], location_bits reach[][PLACEMENT_ROWS], int row);
+
+static row_bitfield normalized_row(const tetromino_shape *shape, int row)
+{
+	return (row_bitfield)(shape->rows[shape->top + row] >> shape->left);
+}
+
+// the first rotation that covers exactly the same squares, so that
+// e.g. all four O rotations count as one placement
+static int canonical_position(const tetromino_masks *masks, int position)
+{
+	const tetromino_shape *shape = masks->shapes + position;
+
+	for (int other = 0; other < position; other++)
+	{
+		const tetromino_shape *candidate = masks->shapes + other;
+		bool same = (candidate->bottom - candidate->top == shape->bottom - shape->top);
+
+		for (int row = 0; same && row <= shape->bottom - shape->top; row++)
+		{
+			same = (normalized_row(candidate, row) == normalized_row(shape, row));
+		}
+
+		if (same)
+		{
+			return other;
+		}
+	}
+
+	return position;
+}
+
+static location_bits legal_locations(matrix *this_matrix, const tetromino_shape *shape, int top)
+{
+	int width = shape->right - shape->left + 1;
+	location_bits legal = 0;
+
+	if (top + shape->top < 0 || top + shape->bottom >= MATRIX_DEPTH)
+	{
+		return 0;
+	}
+
+	for (int x = 0; x + width <= MATRIX_WIDTH; x++)
+	{
+		bool fits = true;
+
+		for (int row = shape->top; fits && row <= shape->bottom; row++)
+		{
+			fits = ((normalized_row(shape, row - shape->top) << x)
+				& this_matrix->rows[top + row]) == 0;
+		}
+
+		if (fits)
+		{
+			legal |= 1u << x;
+		}
+	}
+
+	return legal;
+}
+
+static location_bits shift_locations(location_bits bits, int offset)
+{
+	return (offset >= 0) ? (bits << offset) : (bits >> -offset);
+}
+
+static location_bits spread_sideways(location_bits reach, location_bits legal)
+{
+	location_bits spread;
+
+	for (;;)
+	{
+		spread = (reach | (reach << 1) | (reach >> 1)) & legal;
+		if (spread == reach)
+		{
+			return reach;
+		}
+		reach = spread;
+	}
+}
+
+// Spreads the reach of one row sideways and through rotations until
+// nothing changes. Returns the other rows that kicks added to, as a
+// bit per row.
+static unsigned int flood_row(int type, const tetromino_masks *masks,
+	location_bits legal[][PLACEMENT_ROWS + 1], location_bits reach[][PLACEMENT_ROWS], int row)
+{
+	unsigned int others = 0;
+	bool changed = true;
+
+	while (changed)
+	{
+		changed = false;
+
+		for (int position = 0; position < TETROMINO_POSITIONS; position++)
+		{
+			reach[position][row] = spread_sideways(reach[position][row], legal[position][row]);
+		}
+
+		// rotations keep the pattern box where it is before the kick, so
+		// the bounding box column moves by the difference of the shapes'
+		// left edges plus the kick
+		for (int position = 0; position < TETROMINO_POSITIONS; position++)
+		{
+			for (int turn = 1; turn < TETROMINO_POSITIONS; turn += 2)
+			{
+				int next = (position + turn) % TETROMINO_POSITIONS;
+				int shift = masks->shapes[next].left - masks->shapes[position].left;
+				const kick_offset *kicks = get_kicks(type, position, turn);
+				location_bits waiting = reach[position][row];
+
+				for (int kick = 0; waiting != 0 && kick < SRS_KICKS; kick++)
+				{
+					int target = row + kicks[kick].top;
+					int offset = shift + kicks[kick].left;
+					location_bits fits;
+
+					if (target < 0 || target >= PLACEMENT_ROWS)
+					{
+						continue;
+					}
+
+					fits = shift_locations(waiting, offset) & legal[next][target];
+					waiting &= ~shift_locations(fits, -offset);
+
+					if ((fits & ~reach[next][target]) != 0)
+					{
+						reach[next][target] |= fits;
+						if (target == row)
+						{
+							changed = true;
+						}
+						else
+						{
+							others |= 1u << target;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return others;
+}
+
+// Lists every distinct place the tetromino can come to rest when moved
+// from where it is now with nudges, kicked rotations and soft drops. The
+// list is ordered by rotation, then top, then left; placements array
+// must hold MAX_PLACEMENTS entries. Returns the number of placements.
+int find_placements(matrix *this_matrix, tetromino *this_tetromino, placement *placements)
+{
+	const tetromino_masks *masks;
+	location_bits legal[TETROMINO_POSITIONS][PLACEMENT_ROWS + 1];
+	location_bits reach[TETROMINO_POSITIONS][PLACEMENT_ROWS];
+	location_bits seen[TETROMINO_POSITIONS][MATRIX_DEPTH];
+	int canonical[TETROMINO_POSITIONS];
+	int start_row, start_x, count = 0;
+	unsigned int pending;
+
+	if (this_tetromino->type == illegal_tetromino
+		|| this_tetromino->position < 0
+		|| check_overlap(this_tetromino, this_matrix, 0, 0))
+	{
+		return 0;
+	}
+
+	PROBE_BEGIN("find placements");
+	masks = tetromino_mask_table + this_tetromino->type;
+	start_row = this_tetromino->location.top + TOP_MARGIN;
+	start_x = this_tetromino->location.left + masks->shapes[this_tetromino->position].left;
+
+	for (int position = 0; position < TETROMINO_POSITIONS; position++)
+	{
+		canonical[position] = canonical_position(masks, position);
+		for (int row = 0; row < PLACEMENT_ROWS; row++)
+		{
+			legal[position][row] = legal_locations(this_matrix, masks->shapes + position,
+				row - TOP_MARGIN);
+			reach[position][row] = 0;
+		}
+		legal[position][PLACEMENT_ROWS] = 0;
+
+		for (int top = 0; top < MATRIX_DEPTH; top++)
+		{
+			seen[position][top] = 0;
+		}
+	}
+
+	// the highest row waiting is flooded next, then what it reaches
+	// falls into the row below
+	reach[this_tetromino->position][start_row] = 1u << start_x;
+	pending = 1u << start_row;
+	while (pending != 0)
+	{
+		int row = lowest_bit(pending);
+
+		pending &= pending - 1;
+		pending |= flood_row(this_tetromino->type, masks, legal, reach, row);
+
+		if (row + 1 < PLACEMENT_ROWS)
+		{
+			for (int position = 0; position < TETROMINO_POSITIONS; position++)
+			{
+				location_bits fallen = reach[position][row] & legal[position][row + 1];
+
+				if ((fallen & ~reach[position][row + 1]) != 0)
+				{
+					reach[position][row + 1] |= fallen;
+					pending |= 1u << (row + 1);
+				}
+			}
+		}
+	}
+
+	for (int position = 0; position < TETROMINO_POSITIONS; position++)
+	{
+		const tetromino_shape *shape = masks->shapes + position;
+
+		for (int row = 0; row < PLACEMENT_ROWS; row++)
+		{
+			location_bits landed = reach[position][row] & ~legal[position][row + 1];
+			int top = row - TOP_MARGIN;
+
+			for (int x = 0; landed != 0; x++, landed >>= 1)
+			{
+				location_bits *key;
+
+				if ((landed & 1) == 0)
+				{
+					continue;
+				}
+
+				key = &(seen[canonical[position]][top + shape->top]);
+				if ((*key & (1u << x)) != 0)
+				{
+					continue;
+				}
+				*key |= 1u << x;
+
+				placements[count].position = position;
+				placements[count].top = top;
+				placements[count].left = x - shape->left;
+				count++;
+			}
+		}
+	}
+
+	PROBE_END("find placements");
+	return count;
+}
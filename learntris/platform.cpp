@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include "platform.h"
+
+#ifdef _WIN32
+#include <conio.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct tag_thread_start
+{
+	thread_function function;
+	void *argument;
+} thread_start;
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_main(LPVOID parameter)
+{
+	thread_start start = *(thread_start *)parameter;
+
+	free(parameter);
+	start.function(start.argument);
+	return 0;
+}
+
+bool start_thread(thread_handle *this_thread, thread_function function, void *argument)
+{
+	thread_start *start = (thread_start *)malloc(sizeof(thread_start));
+
+	if (start == NULL)
+	{
+		return false;
+	}
+
+	start->function = function;
+	start->argument = argument;
+
+	*this_thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+	if (*this_thread == NULL)
+	{
+		free(start);
+		return false;
+	}
+
+	return true;
+}
+
+void join_thread(thread_handle *this_thread)
+{
+	WaitForSingleObject(*this_thread, INFINITE);
+	CloseHandle(*this_thread);
+}
+
+void init_lock(lock_handle *this_lock)
+{
+	InitializeCriticalSection(this_lock);
+}
+
+void destroy_lock(lock_handle *this_lock)
+{
+	DeleteCriticalSection(this_lock);
+}
+
+void acquire_lock(lock_handle *this_lock)
+{
+	EnterCriticalSection(this_lock);
+}
+
+void release_lock(lock_handle *this_lock)
+{
+	LeaveCriticalSection(this_lock);
+}
+
+void yield_thread()
+{
+	SwitchToThread();
+}
+
+int count_cpus()
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+double seconds_now()
+{
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// split so that the multiply can't overflow
+unsigned long long nanoseconds_now()
+{
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	unsigned long long ticks, rate;
+
+	if (frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+	ticks = (unsigned long long)counter.QuadPart;
+	rate = (unsigned long long)frequency.QuadPart;
+	return ticks / rate * 1000000000ULL + ticks % rate * 1000000000ULL / rate;
+}
+
+// the console the game was started in, put back by stop_raw_input
+static DWORD saved_input_mode;
+static DWORD saved_output_mode;
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+// the console only; keys come through _getch, which never echoes.
+// The timer period drops to 1 ms so that waits end on time.
+bool start_raw_input()
+{
+	HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+
+	if (!GetConsoleMode(input, &saved_input_mode))
+	{
+		return false;
+	}
+
+	SetConsoleMode(input, saved_input_mode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT));
+	if (GetConsoleMode(output, &saved_output_mode))
+	{
+		SetConsoleMode(output, saved_output_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	}
+	timeBeginPeriod(1);
+	return true;
+}
+
+void stop_raw_input()
+{
+	timeEndPeriod(1);
+	SetConsoleMode(GetStdHandle(STD_INPUT_HANDLE), saved_input_mode);
+	SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), saved_output_mode);
+}
+
+int read_input(unsigned char *buffer, int size)
+{
+	int count = 0;
+
+	while (count < size && _kbhit())
+	{
+		buffer[count++] = (unsigned char)_getch();
+	}
+
+	return count;
+}
+
+// the console handle is also signalled for events that aren't keys,
+// so a true here can still be followed by nothing to read
+bool wait_for_input(double seconds)
+{
+	DWORD milliseconds = (seconds > 0.0) ? (DWORD)(seconds * 1000.0) : 0;
+
+	return WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), milliseconds) == WAIT_OBJECT_0;
+}
+
+void sleep_seconds(double seconds)
+{
+	Sleep((seconds > 0.0) ? (DWORD)(seconds * 1000.0) : 0);
+}
+
+#else
+
+static void *thread_main(void *parameter)
+{
+	thread_start start = *(thread_start *)parameter;
+
+	free(parameter);
+	start.function(start.argument);
+	return NULL;
+}
+
+bool start_thread(thread_handle *this_thread, thread_function function, void *argument)
+{
+	thread_start *start = (thread_start *)malloc(sizeof(thread_start));
+
+	if (start == NULL)
+	{
+		return false;
+	}
+
+	start->function = function;
+	start->argument = argument;
+
+	if (pthread_create(this_thread, NULL, thread_main, start) != 0)
+	{
+		free(start);
+		return false;
+	}
+
+	return true;
+}
+
+void join_thread(thread_handle *this_thread)
+{
+	pthread_join(*this_thread, NULL);
+}
+
+void init_lock(lock_handle *this_lock)
+{
+	pthread_mutex_init(this_lock, NULL);
+}
+
+void destroy_lock(lock_handle *this_lock)
+{
+	pthread_mutex_destroy(this_lock);
+}
+
+void acquire_lock(lock_handle *this_lock)
+{
+	pthread_mutex_lock(this_lock);
+}
+
+void release_lock(lock_handle *this_lock)
+{
+	pthread_mutex_unlock(this_lock);
+}
+
+void yield_thread()
+{
+	sched_yield();
+}
+
+int count_cpus()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (count > 0) ? (int)count : 1;
+}
+
+double seconds_now()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+unsigned long long nanoseconds_now()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+static struct termios saved_terminal;
+static bool terminal_saved = false;
+
+// a terminal goes into non-canonical mode without echo; anything else,
+// a pipe say, is read as it is
+bool start_raw_input()
+{
+	struct termios raw;
+
+	if (tcgetattr(0, &saved_terminal) != 0)
+	{
+		return true;
+	}
+
+	raw = saved_terminal;
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	if (tcsetattr(0, TCSANOW, &raw) != 0)
+	{
+		return false;
+	}
+
+	terminal_saved = true;
+	return true;
+}
+
+void stop_raw_input()
+{
+	if (terminal_saved)
+	{
+		tcsetattr(0, TCSANOW, &saved_terminal);
+		terminal_saved = false;
+	}
+}
+
+int read_input(unsigned char *buffer, int size)
+{
+	struct pollfd input = { 0, POLLIN, 0 };
+	ssize_t count;
+
+	if (poll(&input, 1, 0) <= 0)
+	{
+		return 0;
+	}
+
+	count = read(0, buffer, (size_t)size);
+	if (count < 0)
+	{
+		return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+	}
+
+	return (count == 0) ? -1 : (int)count;
+}
+
+bool wait_for_input(double seconds)
+{
+	struct pollfd input = { 0, POLLIN, 0 };
+	int milliseconds = (seconds > 0.0) ? (int)(seconds * 1000.0) : 0;
+
+	return poll(&input, 1, milliseconds) > 0;
+}
+
+void sleep_seconds(double seconds)
+{
+	struct timespec wait;
+
+	if (seconds <= 0.0)
+	{
+		return;
+	}
+
+	wait.tv_sec = (time_t)seconds;
+	wait.tv_nsec = (long)((seconds - (double)wait.tv_sec) * 1e9);
+	while (nanosleep(&wait, &wait) != 0 && errno == EINTR)
+	{
+	}
+}
+
+#endif
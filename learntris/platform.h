@@ -0,0 +1,73 @@
+#ifndef LEARNTRIS_PLATFORM_H
+#define LEARNTRIS_PLATFORM_H
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#endif
+
+// Just enough threading and timing for the batch modes, on top of
+// Win32 or pthreads.
+
+#ifdef _WIN32
+typedef HANDLE thread_handle;
+typedef CRITICAL_SECTION lock_handle;
+#else
+typedef pthread_t thread_handle;
+typedef pthread_mutex_t lock_handle;
+#endif
+
+typedef void (*thread_function)(void *argument);
+
+bool start_thread(thread_handle *this_thread, thread_function function, void *argument);
+void join_thread(thread_handle *this_thread);
+void init_lock(lock_handle *this_lock);
+void destroy_lock(lock_handle *this_lock);
+void acquire_lock(lock_handle *this_lock);
+void release_lock(lock_handle *this_lock);
+void yield_thread();
+int count_cpus();
+double seconds_now();
+unsigned long long nanoseconds_now();
+
+// A count that one thread writes and another reads, with no lock: what
+// the writer stored before store_release is visible to the reader once
+// load_acquire returns the new count.
+typedef volatile long shared_count;
+
+inline long load_acquire(const shared_count *count)
+{
+#ifdef _WIN32
+	// volatile reads acquire with Visual C++ 2005 and later; the barrier
+	// keeps the compiler from moving reads above it
+	long value = *count;
+
+	_ReadWriteBarrier();
+	return value;
+#else
+	return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void store_release(shared_count *count, long value)
+{
+#ifdef _WIN32
+	_ReadWriteBarrier();
+	*count = value;
+#else
+	__atomic_store_n(count, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Raw keyboard input for --realtime: keys arrive as they are typed,
+// without echo, and reading never blocks. read_input returns how many
+// bytes it read, 0 if none are waiting, or -1 once the input is closed.
+bool start_raw_input();
+void stop_raw_input();
+int read_input(unsigned char *buffer, int size);
+bool wait_for_input(double seconds);
+void sleep_seconds(double seconds);
+
+#endif
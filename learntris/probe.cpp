@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "probe.h"
+#include "platform.h"
+
+#ifdef LEARNTRIS_PROBES
+
+static const char *probe_names[probe_counters_count] =
+{
+	"overlap checks",
+	"collision down checks",
+	"drop column scans",
+	"nudge attempts",
+	"nudges",
+	"locks",
+	"rows cleared"
+};
+
+PROBE_THREAD unsigned long long probe_counts[probe_counters_count];
+
+// allocated by the first event on each thread
+static PROBE_THREAD probe_event *probe_events;
+static PROBE_THREAD int probe_event_count;
+static PROBE_THREAD unsigned long long probe_events_dropped;
+
+void record_probe(const char *name, char phase)
+{
+	probe_event *event;
+
+	if (probe_events == NULL)
+	{
+		probe_events = (probe_event *)malloc(PROBE_EVENTS * sizeof(probe_event));
+	}
+
+	if (probe_events == NULL || probe_event_count == PROBE_EVENTS)
+	{
+		probe_events_dropped++;
+		return;
+	}
+
+	event = probe_events + probe_event_count++;
+	event->name = name;
+	event->phase = phase;
+	event->time = nanoseconds_now();
+}
+
+void reset_probes()
+{
+	for (int counter = 0; counter < probe_counters_count; counter++)
+	{
+		probe_counts[counter] = 0;
+	}
+	probe_event_count = 0;
+	probe_events_dropped = 0;
+}
+
+void report_probes(FILE *file)
+{
+	for (int counter = 0; counter < probe_counters_count; counter++)
+	{
+		fprintf(file, "%-22s %llu\n", probe_names[counter], probe_counts[counter]);
+	}
+
+	if (probe_events_dropped != 0)
+	{
+		fprintf(file, "%-22s %llu\n", "trace events dropped", probe_events_dropped);
+	}
+}
+
+// Timestamps are microseconds from the first event, which is the unit
+// the trace format expects; the nanoseconds go after the point.
+bool write_probe_trace(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	unsigned long long origin = (probe_event_count > 0) ? probe_events[0].time : 0;
+
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fputs("{\"traceEvents\":[\n", file);
+	for (int index = 0; index < probe_event_count; index++)
+	{
+		const probe_event *event = probe_events + index;
+		unsigned long long time = event->time - origin;
+
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":1}%s\n",
+			event->name, event->phase, time / 1000, (unsigned int)(time % 1000),
+			(index + 1 < probe_event_count) ? "," : "");
+	}
+	fputs("],\"displayTimeUnit\":\"ns\"}\n", file);
+
+	return fclose(file) == 0;
+}
+
+#endif
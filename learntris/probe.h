@@ -0,0 +1,66 @@
+#ifndef LEARNTRIS_PROBE_H
+#define LEARNTRIS_PROBE_H
+
+// Event counters and scoped timings inside the engine, for seeing where
+// a game spends its time. They are only compiled in when LEARNTRIS_PROBES
+// is defined; otherwise every PROBE_ macro expands to nothing and the
+// engine is exactly as it would be without them.
+//
+// Counts and trace events are kept per thread, and --replay reports
+// those of its one thread: to stderr, and with --trace as a Chrome
+// trace-event file (chrome://tracing or ui.perfetto.dev).
+
+enum probe_counters
+{
+	probe_overlap_checks,	// check_overlap, for any reason
+	probe_collisions_down,	// check_collision_down
+	probe_column_scans,		// columns looked at by drop_distance
+	probe_nudge_attempts,
+	probe_nudges,			// attempts that moved the piece
+	probe_locks,
+	probe_rows_cleared,
+	probe_counters_count
+};
+
+#ifdef LEARNTRIS_PROBES
+
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#define PROBE_THREAD __declspec(thread)
+#else
+#define PROBE_THREAD __thread
+#endif
+
+// once the buffer is full, later events are counted but dropped
+#define PROBE_EVENTS (1 << 20)
+
+typedef struct tag_probe_event
+{
+	const char *name;
+	char phase;		// 'B' begin or 'E' end, as in the trace format
+	unsigned long long time;
+} probe_event;
+
+extern PROBE_THREAD unsigned long long probe_counts[probe_counters_count];
+
+void record_probe(const char *name, char phase);
+void reset_probes();
+void report_probes(FILE *file);
+bool write_probe_trace(const char *path);
+
+#define PROBE_COUNT(counter) (probe_counts[counter]++)
+#define PROBE_ADD(counter, amount) (probe_counts[counter] += (amount))
+#define PROBE_BEGIN(name) record_probe(name, 'B')
+#define PROBE_END(name) record_probe(name, 'E')
+
+#else
+
+#define PROBE_COUNT(counter) ((void)0)
+#define PROBE_ADD(counter, amount) ((void)0)
+#define PROBE_BEGIN(name) ((void)0)
+#define PROBE_END(name) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include "randomizer.h"
+
+static unsigned long long next_bits(random_state *state);
+static int deal_piece(piece_bag *this_bag);
+
+// splitmix64, so that every game gets its own independent stream. The
+// whole seed is mixed first, so seeds that differ only in their high
+// bits still deal different games.
+random_state seed_random(unsigned long seed, long stream)
+{
+	random_state state = (random_state)seed;
+
+	state = next_bits(&state) ^ (random_state)stream;
+	next_random(&state, 1);
+	return state;
+}
+
+static unsigned long long next_bits(random_state *state)
+{
+	random_state z;
+
+	*state += 0x9E3779B97F4A7C15ULL;
+	z = *state;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+unsigned int next_random(random_state *state, unsigned int limit)
+{
+	return (unsigned int)(((next_bits(state) >> 32) * limit) >> 32);
+}
+
+// A new stream for a part of the work that has to be reproducible on
+// its own, e.g. the pieces of a game apart from its moves. Takes one
+// draw from state.
+random_state split_random(random_state *state)
+{
+	return next_bits(state);
+}
+
+void init_bag(piece_bag *this_bag, random_state random, int preview)
+{
+	this_bag->random = random;
+	this_bag->bag_left = 0;
+	this_bag->queue_start = 0;
+	this_bag->queue_count = 0;
+	this_bag->preview = 0;
+	set_preview(this_bag, preview);
+}
+
+// from 0 to BAG_MAX_PREVIEW pieces
+void set_preview(piece_bag *this_bag, int preview)
+{
+	if (preview < 0)
+	{
+		preview = 0;
+	}
+	else if (preview > BAG_MAX_PREVIEW)
+	{
+		preview = BAG_MAX_PREVIEW;
+	}
+
+	this_bag->preview = preview;
+	while (this_bag->queue_count < preview)
+	{
+		this_bag->queue[(this_bag->queue_start + this_bag->queue_count) % BAG_QUEUE_SIZE]
+			= deal_piece(this_bag);
+		this_bag->queue_count++;
+	}
+}
+
+// Deals one of the pieces left in the bag at random, refilling it when
+// it is empty: a Fisher-Yates shuffle done a piece at a time.
+static int deal_piece(piece_bag *this_bag)
+{
+	int pick, type;
+
+	if (this_bag->bag_left == 0)
+	{
+		for (type = 0; type <= tetromino_Z; type++)
+		{
+			this_bag->bag[type] = type;
+		}
+		this_bag->bag_left = tetromino_Z + 1;
+	}
+
+	pick = (int)next_random(&(this_bag->random), this_bag->bag_left);
+	type = this_bag->bag[pick];
+	this_bag->bag_left--;
+	this_bag->bag[pick] = this_bag->bag[this_bag->bag_left];
+	return type;
+}
+
+int next_piece(piece_bag *this_bag)
+{
+	int type;
+
+	if (this_bag->queue_count == 0)
+	{
+		return deal_piece(this_bag);
+	}
+
+	type = this_bag->queue[this_bag->queue_start];
+	this_bag->queue_start = (this_bag->queue_start + 1) % BAG_QUEUE_SIZE;
+	this_bag->queue_count--;
+	set_preview(this_bag, this_bag->preview);
+	return type;
+}
+
+// index 0 is the piece next_piece will return
+int peek_piece(const piece_bag *this_bag, int index)
+{
+	return this_bag->queue[(this_bag->queue_start + index) % BAG_QUEUE_SIZE];
+}
@@ -0,0 +1,36 @@
+#ifndef LEARNTRIS_RANDOMIZER_H
+#define LEARNTRIS_RANDOMIZER_H
+
+#include "learntris.h"
+
+#define BAG_QUEUE_SIZE 16
+#define BAG_MAX_PREVIEW BAG_QUEUE_SIZE
+#define BAG_DEFAULT_PREVIEW 5
+
+typedef unsigned long long random_state;
+
+// The 7-bag randomizer: each run of seven pieces is one of every
+// tetromino, shuffled. Pieces are drawn into the queue ahead of time so
+// that the next preview of them can be shown. How many are shown never
+// changes which pieces come: the same random_state always deals the
+// same sequence, on any thread.
+typedef struct tag_piece_bag
+{
+	random_state random;
+	int bag[tetromino_Z + 1];
+	int bag_left;			// bag[0] to bag[bag_left - 1] still to be dealt
+	int queue[BAG_QUEUE_SIZE];
+	int queue_start;
+	int queue_count;		// dealt but not yet taken, at least preview
+	int preview;
+} piece_bag;
+
+random_state seed_random(unsigned long seed, long stream);
+unsigned int next_random(random_state *state, unsigned int limit);
+random_state split_random(random_state *state);
+void init_bag(piece_bag *this_bag, random_state random, int preview);
+void set_preview(piece_bag *this_bag, int preview);
+int next_piece(piece_bag *this_bag);
+int peek_piece(const piece_bag *this_bag, int index);
+
+#endif
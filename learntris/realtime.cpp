@@ -0,0 +1,529 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "realtime.h"
+#include "frontend.h"
+#include "platform.h"
+
+#define INPUT_CHUNK 64
+#define REPEAT_GAP 0.08			// seconds: the same shift key this soon after, in a later read, is a repeat
+#define RELEASE_TIMEOUT 0.1		// seconds without a repeat before a held key is let go
+#define MAX_CATCH_UP 5			// ticks run back to back after a stall; the rest are dropped
+#define SPIN_SECONDS 0.002		// the last of every wait is spun, not slept
+
+// Terminals only send characters, never key up, so a shift key counts
+// as held once it repeats, and as let go once its repeats stop.
+typedef struct tag_shift_keys
+{
+	int last;			// direction of the last shift key, 0 for none
+	int held;			// direction being held, 0 for none
+	double seen;		// when the last shift key arrived
+} shift_keys;
+
+// how well frames kept to the ticks, and how long keys waited to be seen
+typedef struct tag_frame_stats
+{
+	long frames;
+	long dropped_ticks;
+	double lateness_total;	// how long after its tick each frame was out
+	double lateness_max;
+	long keys_shown;		// frames that showed at least one key
+	double latency_total;	// from reading the oldest key to showing it
+	double latency_max;
+	double waiting_since;	// the oldest key not shown yet, or 0
+} frame_stats;
+
+const realtime_config default_realtime_config =
+{
+	48,		// gravity: 0.8 seconds a row
+	30,		// lock_delay: half a second
+	15,		// lock_resets
+	10,		// das: 167 ms
+	2		// arr: 33 ms
+};
+
+static void spawn_next(realtime_game *this_game);
+static void lock_piece(realtime_game *this_game);
+static void moved(realtime_game *this_game);
+static void handle_key(realtime_game *this_game, shift_keys *keys, int key, double now);
+static void draw_frame(realtime_game *this_game, output_sink *out);
+static void show_frame(realtime_game *this_game, output_sink *out, frame_stats *stats, double due);
+static void print_stats(realtime_game *this_game, frame_stats *stats);
+static int realtime_usage(const char *program);
+
+void init_realtime(realtime_game *this_game, const realtime_config *config, unsigned long seed)
+{
+	init(&(this_game->state));
+	this_game->config = *config;
+	init_bag(&(this_game->pieces), seed_random(seed, 0), 0);
+	this_game->ticks = 0;
+	this_game->shift = 0;
+	this_game->shift_timer = 0;
+	this_game->shift_repeating = false;
+	this_game->paused = false;
+	this_game->over = false;
+	spawn_next(this_game);
+}
+
+static void spawn_next(realtime_game *this_game)
+{
+	int type = next_piece(&(this_game->pieces));
+
+	if (!spawn_tetromino(&(this_game->state.active_tetromino), type, &(this_game->state.main_matrix)))
+	{
+		this_game->over = true;
+	}
+
+	this_game->gravity_timer = this_game->config.gravity;
+	this_game->lock_timer = this_game->config.lock_delay;
+	this_game->lock_resets = this_game->config.lock_resets;
+	this_game->changed = true;
+}
+
+// what 'V' then 's' do, then the next piece
+static void lock_piece(realtime_game *this_game)
+{
+	if (!lock_tetromino(&(this_game->state)))
+	{
+		this_game->over = true;
+	}
+
+	exec_step(&(this_game->state));
+	if (!this_game->over)
+	{
+		spawn_next(this_game);
+	}
+	this_game->changed = true;
+}
+
+// a move or turn that worked while resting gives the piece more time,
+// a limited number of times
+static void moved(realtime_game *this_game)
+{
+	this_game->changed = true;
+
+	if (this_game->lock_resets > 0
+		&& check_collision_down(&(this_game->state.active_tetromino), &(this_game->state.main_matrix)))
+	{
+		this_game->lock_timer = this_game->config.lock_delay;
+		this_game->lock_resets--;
+	}
+}
+
+// One key, with the protocol's meaning: '<' '>' shift, ')' '(' turn,
+// 'v' soft drop, 'V' hard drop, '!' pause. Anything else is ignored.
+void realtime_key(realtime_game *this_game, int key)
+{
+	tetromino *active_tetromino = &(this_game->state.active_tetromino);
+	matrix *main_matrix = &(this_game->state.main_matrix);
+
+	if (this_game->over)
+	{
+		return;
+	}
+
+	if (key == '!')
+	{
+		this_game->paused = !this_game->paused;
+		this_game->changed = true;
+		return;
+	}
+
+	if (this_game->paused)
+	{
+		return;
+	}
+
+	switch (key)
+	{
+	case '<':
+		if (nudge_left(active_tetromino, main_matrix))
+		{
+			moved(this_game);
+		}
+		break;
+	case '>':
+		if (nudge_right(active_tetromino, main_matrix))
+		{
+			moved(this_game);
+		}
+		break;
+	case ')':
+		if (rotate_right(active_tetromino, main_matrix))
+		{
+			moved(this_game);
+		}
+		break;
+	case '(':
+		if (rotate_left(active_tetromino, main_matrix))
+		{
+			moved(this_game);
+		}
+		break;
+	case 'v':
+		if (nudge_down(active_tetromino, main_matrix))
+		{
+			this_game->gravity_timer = this_game->config.gravity;
+			this_game->changed = true;
+		}
+		break;
+	case 'V':
+		active_tetromino->location.top += drop_distance(active_tetromino, main_matrix);
+		lock_piece(this_game);
+		break;
+	default:
+		break;
+	}
+}
+
+// the shift itself is realtime_key's; this starts the auto repeat,
+// das ticks from now
+void hold_shift(realtime_game *this_game, int direction)
+{
+	this_game->shift = direction;
+	this_game->shift_timer = this_game->config.das;
+	this_game->shift_repeating = false;
+}
+
+void release_shift(realtime_game *this_game)
+{
+	this_game->shift = 0;
+	this_game->shift_repeating = false;
+}
+
+// One fixed step: the held shift repeats, then gravity, then the lock
+// delay runs down while the piece rests on the stack.
+void realtime_tick(realtime_game *this_game)
+{
+	tetromino *active_tetromino = &(this_game->state.active_tetromino);
+	matrix *main_matrix = &(this_game->state.main_matrix);
+
+	if (this_game->paused || this_game->over)
+	{
+		return;
+	}
+
+	this_game->ticks++;
+
+	if (this_game->shift != 0 && --this_game->shift_timer <= 0)
+	{
+		bool shifted = false;
+
+		while ((this_game->shift < 0) ? nudge_left(active_tetromino, main_matrix)
+			: nudge_right(active_tetromino, main_matrix))
+		{
+			shifted = true;
+			if (this_game->config.arr > 0)
+			{
+				break;
+			}
+		}
+
+		if (shifted)
+		{
+			moved(this_game);
+		}
+		this_game->shift_timer = (this_game->config.arr > 0) ? this_game->config.arr : 1;
+		this_game->shift_repeating = true;
+	}
+
+	if (!check_collision_down(active_tetromino, main_matrix))
+	{
+		this_game->lock_timer = this_game->config.lock_delay;
+		if (--this_game->gravity_timer <= 0)
+		{
+			nudge_down(active_tetromino, main_matrix);
+			this_game->gravity_timer = this_game->config.gravity;
+			this_game->changed = true;
+		}
+	}
+	else if (--this_game->lock_timer <= 0)
+	{
+		lock_piece(this_game);
+	}
+}
+
+// Every press of a shift key moves the piece until the auto repeat has
+// started. The same key again within REPEAT_GAP, read after the last
+// one, is the terminal repeating it, so from then on it is held and the
+// auto repeat starts das ticks later; keys that arrive in the same read
+// are taps, however many there are.
+static void handle_key(realtime_game *this_game, shift_keys *keys, int key, double now)
+{
+	int direction = (key == '<') ? -1 : (key == '>') ? 1 : 0;
+
+	if (direction == 0)
+	{
+		realtime_key(this_game, key);
+		return;
+	}
+
+	if (keys->held == direction && this_game->shift_repeating)
+	{
+		keys->seen = now;
+		return;
+	}
+
+	realtime_key(this_game, key);
+	if (keys->last == direction && now > keys->seen && now - keys->seen < REPEAT_GAP)
+	{
+		if (keys->held != direction)
+		{
+			hold_shift(this_game, direction);
+			keys->held = direction;
+		}
+	}
+	else if (keys->held != 0)
+	{
+		release_shift(this_game);
+		keys->held = 0;
+	}
+
+	keys->last = direction;
+	keys->seen = now;
+}
+
+// the cursor goes home and the whole frame is written over the last
+static void draw_frame(realtime_game *this_game, output_sink *out)
+{
+	char text[FRAME_SIZE + 64];
+	char *cursor = text;
+
+	memcpy(cursor, "\x1b[H", 3);
+	cursor += 3;
+	format_matrix(&(this_game->state.main_matrix), cursor);
+	overlay_tetromino(cursor, &(this_game->state.active_tetromino));
+	cursor += FRAME_SIZE;
+
+	memcpy(cursor, "score ", 6);
+	cursor += 6;
+	cursor += format_int(cursor, this_game->state.score);
+	memcpy(cursor, " lines ", 7);
+	cursor += 7;
+	cursor += format_int(cursor, this_game->state.num_lines);
+	if (this_game->over)
+	{
+		memcpy(cursor, "  Game Over", 11);
+		cursor += 11;
+	}
+	else if (this_game->paused)
+	{
+		memcpy(cursor, "  Paused", 8);
+		cursor += 8;
+	}
+	memcpy(cursor, "\x1b[K\n", 4);
+	cursor += 4;
+
+	write_output(out, text, cursor - text);
+}
+
+// due is when the tick this frame shows was meant to happen
+static void show_frame(realtime_game *this_game, output_sink *out, frame_stats *stats, double due)
+{
+	double shown;
+
+	draw_frame(this_game, out);
+	fflush(stdout);
+	shown = seconds_now();
+
+	stats->frames++;
+	stats->lateness_total += shown - due;
+	if (shown - due > stats->lateness_max)
+	{
+		stats->lateness_max = shown - due;
+	}
+
+	if (stats->waiting_since != 0.0)
+	{
+		stats->keys_shown++;
+		stats->latency_total += shown - stats->waiting_since;
+		if (shown - stats->waiting_since > stats->latency_max)
+		{
+			stats->latency_max = shown - stats->waiting_since;
+		}
+		stats->waiting_since = 0.0;
+	}
+
+	this_game->changed = false;
+}
+
+static void print_stats(realtime_game *this_game, frame_stats *stats)
+{
+	fprintf(stderr, "%ld ticks, %ld frames, %ld ticks dropped\n",
+		this_game->ticks, stats->frames, stats->dropped_ticks);
+	fprintf(stderr, "frame after tick: mean %.3f ms, max %.3f ms\n",
+		(stats->frames > 0) ? stats->lateness_total * 1000.0 / stats->frames : 0.0,
+		stats->lateness_max * 1000.0);
+	fprintf(stderr, "key to frame: %ld frames, mean %.3f ms, max %.3f ms\n", stats->keys_shown,
+		(stats->keys_shown > 0) ? stats->latency_total * 1000.0 / stats->keys_shown : 0.0,
+		stats->latency_max * 1000.0);
+}
+
+static int realtime_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s --realtime [--seed n] [--gravity t] [--lock-delay t]"
+		" [--das t] [--arr t] [--ticks n]\n", program);
+	return 1;
+}
+
+// learntris --realtime [--seed n] [--gravity t] [--lock-delay t]
+//     [--das t] [--arr t] [--ticks n]
+// Plays in the terminal against the clock, REALTIME_HZ ticks a second;
+// the settings are in ticks. Keys are read as soon as they arrive and
+// shown on the next tick's frame. --ticks stops after that many ticks,
+// for running it headless. 'q' quits; the frame pacing and how long
+// keys took to show go to stderr at the end.
+int realtime_main(int argc, char *argv[])
+{
+	static char output_buffer[FRAME_SIZE * 4];
+	realtime_config config = default_realtime_config;
+	realtime_game game;
+	shift_keys keys = { 0, 0, 0.0 };
+	frame_stats stats;
+	output_sink out;
+	unsigned long seed = 1;
+	long tick_limit = 0;
+	bool input_open = true;
+	bool quit = false;
+	double tick_seconds = 1.0 / REALTIME_HZ;
+	double deadline;
+
+	for (int i = 2; i < argc; i += 2)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		int ticks = (value != NULL) ? atoi(value) : 0;
+
+		if (value == NULL)
+		{
+			return realtime_usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			seed = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--gravity") == 0 && ticks > 0)
+		{
+			config.gravity = ticks;
+		}
+		else if (strcmp(argv[i], "--lock-delay") == 0 && ticks > 0)
+		{
+			config.lock_delay = ticks;
+		}
+		else if (strcmp(argv[i], "--das") == 0 && ticks >= 0)
+		{
+			config.das = ticks;
+		}
+		else if (strcmp(argv[i], "--arr") == 0 && ticks >= 0)
+		{
+			config.arr = ticks;
+		}
+		else if (strcmp(argv[i], "--ticks") == 0 && ticks >= 0)
+		{
+			tick_limit = ticks;
+		}
+		else
+		{
+			return realtime_usage(argv[0]);
+		}
+	}
+
+	if (!start_raw_input())
+	{
+		fprintf(stderr, "cannot read the keyboard\n");
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+	init_file_output(&out, stdout);
+	init_realtime(&game, &config, seed);
+
+	write_text(&out, "\x1b[2J\x1b[?25l");
+	deadline = seconds_now();
+	show_frame(&game, &out, &stats, deadline);
+	deadline += tick_seconds;
+
+	while (!quit && !game.over && (tick_limit == 0 || game.ticks < tick_limit))
+	{
+		double now = seconds_now();
+
+		if (input_open)
+		{
+			unsigned char input[INPUT_CHUNK];
+			int count = read_input(input, INPUT_CHUNK);
+
+			if (count < 0)
+			{
+				input_open = false;
+			}
+			for (int i = 0; i < count && !quit; i++)
+			{
+				if (input[i] == 'q')
+				{
+					quit = true;
+				}
+				handle_key(&game, &keys, input[i], now);
+			}
+			if (count > 0 && stats.waiting_since == 0.0)
+			{
+				stats.waiting_since = now;
+			}
+		}
+
+		if (keys.held != 0 && now - keys.seen > RELEASE_TIMEOUT)
+		{
+			release_shift(&game);
+			keys.held = 0;
+		}
+
+		if (now >= deadline)
+		{
+			double due = deadline;
+
+			for (int behind = 0; now >= deadline; behind++)
+			{
+				if (behind < MAX_CATCH_UP)
+				{
+					realtime_tick(&game);
+				}
+				else
+				{
+					stats.dropped_ticks++;
+				}
+				due = deadline;
+				deadline += tick_seconds;
+			}
+
+			if (game.changed || stats.waiting_since != 0.0)
+			{
+				show_frame(&game, &out, &stats, due);
+			}
+			continue;
+		}
+
+		// sleep, or wait for a key, until just before the tick is due,
+		// then spin the rest so the tick isn't late
+		if (deadline - now > SPIN_SECONDS)
+		{
+			if (input_open)
+			{
+				wait_for_input(deadline - now - SPIN_SECONDS);
+			}
+			else
+			{
+				sleep_seconds(deadline - now - SPIN_SECONDS);
+			}
+		}
+	}
+
+	if (game.changed)
+	{
+		show_frame(&game, &out, &stats, seconds_now());
+	}
+	write_text(&out, "\x1b[?25h");
+	fflush(stdout);
+	stop_raw_input();
+
+	print_stats(&game, &stats);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef LEARNTRIS_REALTIME_H
+#define LEARNTRIS_REALTIME_H
+
+#include "learntris.h"
+#include "randomizer.h"
+
+// the fixed timestep: the game only ever moves on in whole ticks
+#define REALTIME_HZ 60
+
+// Everything is in ticks, so a game fed the same keys on the same ticks
+// always plays out the same.
+typedef struct tag_realtime_config
+{
+	int gravity;		// ticks for the piece to fall a row by itself
+	int lock_delay;		// ticks a piece may rest on the stack before it locks
+	int lock_resets;	// moves per piece that start the lock delay again
+	int das;			// ticks a shift is held before it repeats
+	int arr;			// ticks between repeats, 0 to go straight to the wall
+} realtime_config;
+
+typedef struct tag_realtime_game
+{
+	game_state state;
+	realtime_config config;
+	piece_bag pieces;
+	long ticks;
+	int gravity_timer;	// ticks until the piece falls by itself
+	int lock_timer;		// ticks left resting before it locks
+	int lock_resets;	// left for this piece
+	int shift;			// direction held: -1 left, 1 right, 0 none
+	int shift_timer;	// ticks until the held shift repeats
+	bool shift_repeating;	// das has run out and the held shift is repeating
+	bool paused;
+	bool over;
+	bool changed;		// since the last frame was drawn
+} realtime_game;
+
+extern const realtime_config default_realtime_config;
+
+void init_realtime(realtime_game *this_game, const realtime_config *config, unsigned long seed);
+void realtime_key(realtime_game *this_game, int key);
+void hold_shift(realtime_game *this_game, int direction);
+void release_shift(realtime_game *this_game);
+void realtime_tick(realtime_game *this_game);
+int realtime_main(int argc, char *argv[]);
+
+#endif
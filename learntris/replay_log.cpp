@@ -0,0 +1,930 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay_log.h"
+
+#define LOG_VERSION 3
+#define LOG_HEADER_SIZE 5
+#define LOG_TRAILER_SIZE 12
+#define LOG_BUFFER_SIZE (1 << 20)
+#define VARINT_MAX 10
+// three bits a square, in the order of square_values
+#define PACKED_SQUARES ((MATRIX_WIDTH * MATRIX_DEPTH * 3 + 7) / 8)
+// the history ring and everything else, with room to spare
+#define CHECKPOINT_MAX (HISTORY_SIZE + 256)
+
+static const char square_values[] = ".rgbocmy";
+
+// The moves go out through a FILE, but the unit being read from the
+// script is held back until it is complete, and a command that repeats
+// is held back until it stops repeating.
+typedef struct tag_log_writer
+{
+	FILE *file;
+	unsigned long long offset;		// bytes written so far
+	unsigned long long moves;
+	unsigned long interval;
+	int run_command;				// the command repeating, 0 for none
+	unsigned long long run_length;
+	unsigned long long last_checkpoint;
+	unsigned char *unit;			// what the current command read
+	size_t unit_size;
+	size_t unit_capacity;
+	unsigned char *index;			// checkpoint offsets, as varints
+	size_t index_size;
+	size_t index_capacity;
+	unsigned long checkpoints;
+	unsigned char checkpoint[CHECKPOINT_MAX];	// the one being written
+} log_writer;
+
+typedef struct tag_log_reader
+{
+	const unsigned char *next;
+	const unsigned char *end;
+} log_reader;
+
+static int put_varint(unsigned char *out, unsigned long long value);
+static bool get_varint(log_reader *in, unsigned long long *value);
+static unsigned long long zigzag(int value);
+static int unzigzag(unsigned long long value);
+static void pack_squares(const char *squares, unsigned char *out);
+static void unpack_squares(const unsigned char *in, char *squares);
+static bool append_bytes(unsigned char **data, size_t *size, size_t *capacity,
+	const unsigned char *bytes, size_t length);
+static void write_bytes(log_writer *this_writer, const unsigned char *bytes, size_t length);
+static void write_varint(log_writer *this_writer, unsigned long long value);
+static void flush_run(log_writer *this_writer);
+static void write_move(log_writer *this_writer, session *this_session, int command);
+static int save_checkpoint(const session *this_session, unsigned char *out);
+static bool load_checkpoint(log_reader *in, session *this_session);
+static const unsigned char *record_operands(log_writer *this_writer, session *this_session,
+	const unsigned char *next, const unsigned char *end, output_sink *out);
+static bool replay_operands(log_reader *in, session *this_session, output_sink *out);
+static bool run_moves(log_reader *in, session *this_session, unsigned long long move,
+	unsigned long long until, output_sink *out);
+static int record_main(int argc, char *argv[]);
+static int play_main(int argc, char *argv[]);
+static int seek_main(int argc, char *argv[]);
+
+// little endian base 128, low seven bits first
+static int put_varint(unsigned char *out, unsigned long long value)
+{
+	int length = 0;
+
+	while (value >= 0x80)
+	{
+		out[length++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	out[length++] = (unsigned char)value;
+	return length;
+}
+
+static bool get_varint(log_reader *in, unsigned long long *value)
+{
+	unsigned long long result = 0;
+
+	for (int shift = 0; shift < 7 * VARINT_MAX; shift += 7)
+	{
+		if (in->next >= in->end)
+		{
+			return false;
+		}
+
+		result |= (unsigned long long)(*in->next & 0x7f) << shift;
+		if ((*in->next++ & 0x80) == 0)
+		{
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// signed values as small unsigned ones: 0, -1, 1, -2, ...
+static unsigned long long zigzag(int value)
+{
+	return (value < 0) ? ((unsigned long long)(-(long long)value) << 1) - 1
+		: (unsigned long long)value << 1;
+}
+
+static int unzigzag(unsigned long long value)
+{
+	return ((value & 1) != 0) ? -(int)(value >> 1) - 1 : (int)(value >> 1);
+}
+
+// anything that isn't a color is packed as empty, as 'g' reads it
+static void pack_squares(const char *squares, unsigned char *out)
+{
+	unsigned int bits = 0;
+	int count = 0;
+
+	memset(out, 0, PACKED_SQUARES);
+	for (int square = 0; square < MATRIX_WIDTH * MATRIX_DEPTH; square++)
+	{
+		const char *value = strchr(square_values, squares[square]);
+
+		bits |= (unsigned int)((value != NULL && *value != '\0') ? value - square_values : 0) << count;
+		count += 3;
+		if (count >= 8)
+		{
+			*out++ = (unsigned char)bits;
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	if (count > 0)
+	{
+		*out = (unsigned char)bits;
+	}
+}
+
+static void unpack_squares(const unsigned char *in, char *squares)
+{
+	unsigned int bits = 0;
+	int count = 0;
+
+	for (int square = 0; square < MATRIX_WIDTH * MATRIX_DEPTH; square++)
+	{
+		if (count < 3)
+		{
+			bits |= (unsigned int)*in++ << count;
+			count += 8;
+		}
+
+		squares[square] = square_values[bits & 7];
+		bits >>= 3;
+		count -= 3;
+	}
+}
+
+static bool append_bytes(unsigned char **data, size_t *size, size_t *capacity,
+	const unsigned char *bytes, size_t length)
+{
+	if (*size + length > *capacity)
+	{
+		size_t new_capacity = (*capacity == 0) ? 256 : *capacity * 2;
+		unsigned char *new_data;
+
+		while (new_capacity < *size + length)
+		{
+			new_capacity *= 2;
+		}
+
+		new_data = (unsigned char *)realloc(*data, new_capacity);
+		if (new_data == NULL)
+		{
+			return false;
+		}
+		*data = new_data;
+		*capacity = new_capacity;
+	}
+
+	memcpy(*data + *size, bytes, length);
+	*size += length;
+	return true;
+}
+
+static void write_bytes(log_writer *this_writer, const unsigned char *bytes, size_t length)
+{
+	fwrite(bytes, 1, length, this_writer->file);
+	this_writer->offset += length;
+}
+
+static void write_varint(log_writer *this_writer, unsigned long long value)
+{
+	unsigned char bytes[VARINT_MAX];
+
+	write_bytes(this_writer, bytes, put_varint(bytes, value));
+}
+
+static void flush_run(log_writer *this_writer)
+{
+	if (this_writer->run_command != 0)
+	{
+		write_varint(this_writer, ((this_writer->run_length - 1) << 7) | this_writer->run_command);
+		this_writer->run_command = 0;
+	}
+}
+
+// Writes a command and what it read, then the game as it is now if that
+// was the last move before a checkpoint.
+static void write_move(log_writer *this_writer, session *this_session, int command)
+{
+	if (this_writer->unit_size == 0 && command < 0x80 && command == this_writer->run_command)
+	{
+		this_writer->run_length++;
+	}
+	else
+	{
+		flush_run(this_writer);
+		if (this_writer->unit_size == 0 && command < 0x80)
+		{
+			this_writer->run_command = command;
+			this_writer->run_length = 1;
+		}
+		else
+		{
+			write_varint(this_writer, (command < 0x80) ? command : (unsigned long long)command << 7);
+			write_bytes(this_writer, this_writer->unit, this_writer->unit_size);
+		}
+	}
+
+	if (++this_writer->moves % this_writer->interval == 0)
+	{
+		unsigned char delta[VARINT_MAX];
+		int length;
+
+		flush_run(this_writer);
+		append_bytes(&(this_writer->index), &(this_writer->index_size), &(this_writer->index_capacity),
+			delta, put_varint(delta, this_writer->offset - this_writer->last_checkpoint));
+		this_writer->last_checkpoint = this_writer->offset;
+		this_writer->checkpoints++;
+
+		length = save_checkpoint(this_session, this_writer->checkpoint);
+		write_varint(this_writer, 0);
+		write_varint(this_writer, length);
+		write_bytes(this_writer, this_writer->checkpoint, length);
+	}
+}
+
+// Everything a game carries from one command to the next, except the
+// latency figures. The history is moved to the start of the ring.
+static int save_checkpoint(const session *this_session, unsigned char *out)
+{
+	const game_state *state = &(this_session->state);
+	const history *moves = &(this_session->moves);
+	const piece_bag *pieces = &(this_session->pieces);
+	int length = 0;
+
+	pack_squares(state->main_matrix.squares, out);
+	length += PACKED_SQUARES;
+	length += put_varint(out + length, state->main_matrix.touched_rows);
+	length += put_varint(out + length, zigzag(state->active_tetromino.type));
+	length += put_varint(out + length, zigzag(state->active_tetromino.position));
+	length += put_varint(out + length, zigzag(state->active_tetromino.location.top));
+	length += put_varint(out + length, zigzag(state->active_tetromino.location.left));
+	length += put_varint(out + length, zigzag(state->score));
+	length += put_varint(out + length, zigzag(state->num_lines));
+	length += put_varint(out + length, (this_session->title_displayed ? 1 : 0)
+		| (this_session->game_is_over ? 2 : 0) | ((this_session->mode == mode_quit) ? 4 : 0));
+
+	length += put_varint(out + length, pieces->random);
+	length += put_varint(out + length, pieces->bag_left);
+	for (int i = 0; i < pieces->bag_left; i++)
+	{
+		out[length++] = (unsigned char)pieces->bag[i];
+	}
+	length += put_varint(out + length, pieces->queue_count);
+	for (int i = 0; i < pieces->queue_count; i++)
+	{
+		out[length++] = (unsigned char)peek_piece(pieces, i);
+	}
+	length += put_varint(out + length, pieces->preview);
+
+	length += put_varint(out + length, moves->newest - moves->oldest);
+	length += put_varint(out + length, moves->current - moves->oldest);
+	for (unsigned int i = moves->oldest; i != moves->newest; i++)
+	{
+		out[length++] = moves->ring[i & (HISTORY_SIZE - 1)];
+	}
+
+	return length;
+}
+
+// Everything is range checked, since a damaged log must not be able to
+// put the session in a state the engine can't handle.
+static bool load_checkpoint(log_reader *in, session *this_session)
+{
+	game_state *state = &(this_session->state);
+	matrix *this_matrix = &(state->main_matrix);
+	history *moves = &(this_session->moves);
+	piece_bag *pieces = &(this_session->pieces);
+	unsigned long long values[10];
+	unsigned long long newest, current;
+
+	init_session(this_session);
+	if (in->end - in->next < PACKED_SQUARES)
+	{
+		return false;
+	}
+
+	unpack_squares(in->next, this_matrix->squares);
+	in->next += PACKED_SQUARES;
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		row_bitfield bits = 0;
+
+		for (int col = 0; col < MATRIX_WIDTH; col++)
+		{
+			if (this_matrix->squares[MATRIX_WIDTH * row + col] != empty)
+			{
+				bits |= 1 << col;
+			}
+		}
+		this_matrix->rows[row] = bits;
+	}
+	sync_matrix(this_matrix);
+
+	for (int i = 0; i < 10; i++)
+	{
+		if (!get_varint(in, values + i))
+		{
+			return false;
+		}
+	}
+
+	this_matrix->touched_rows = (unsigned int)values[0];
+	state->active_tetromino.type = unzigzag(values[1]);
+	state->active_tetromino.position = unzigzag(values[2]);
+	state->active_tetromino.location.top = unzigzag(values[3]);
+	state->active_tetromino.location.left = unzigzag(values[4]);
+	state->score = unzigzag(values[5]);
+	state->num_lines = unzigzag(values[6]);
+	this_session->title_displayed = (values[7] & 1) != 0;
+	this_session->game_is_over = (values[7] & 2) != 0;
+	this_session->mode = ((values[7] & 4) != 0) ? mode_quit : mode_play;
+
+	if ((this_matrix->touched_rows & ~ALL_ROWS) != 0 || !valid_tetromino(&(state->active_tetromino)))
+	{
+		return false;
+	}
+
+	pieces->random = values[8];
+	if (values[9] > tetromino_Z + 1 || (unsigned long long)(in->end - in->next) < values[9])
+	{
+		return false;
+	}
+	pieces->bag_left = (int)values[9];
+	for (int i = 0; i < pieces->bag_left; i++)
+	{
+		pieces->bag[i] = *in->next++;
+		if (pieces->bag[i] > tetromino_Z)
+		{
+			return false;
+		}
+	}
+	if (!get_varint(in, values) || values[0] > BAG_QUEUE_SIZE
+		|| (unsigned long long)(in->end - in->next) < values[0])
+	{
+		return false;
+	}
+	pieces->queue_start = 0;
+	pieces->queue_count = (int)values[0];
+	for (int i = 0; i < pieces->queue_count; i++)
+	{
+		pieces->queue[i] = *in->next++;
+		if (pieces->queue[i] > tetromino_Z)
+		{
+			return false;
+		}
+	}
+
+	if (!get_varint(in, values) || values[0] > (unsigned long long)pieces->queue_count
+		|| !get_varint(in, &newest) || !get_varint(in, &current)
+		|| newest > HISTORY_SIZE || current > newest
+		|| (unsigned long long)(in->end - in->next) < newest)
+	{
+		return false;
+	}
+	pieces->preview = (int)values[0];
+	memcpy(moves->ring, in->next, (size_t)newest);
+	in->next += newest;
+	moves->oldest = 0;
+	moves->current = (unsigned int)current;
+	moves->newest = (unsigned int)newest;
+	return history_valid(moves);
+}
+
+// Reads what the command just fed wants next, until the session is back
+// to taking commands, and keeps it in the writer's unit. Returns NULL if
+// the script ends first.
+static const unsigned char *record_operands(log_writer *this_writer, session *this_session,
+	const unsigned char *next, const unsigned char *end, output_sink *out)
+{
+	this_writer->unit_size = 0;
+
+	while (this_session->mode != mode_play && this_session->mode != mode_quit)
+	{
+		unsigned char bytes[PACKED_SQUARES];
+		const unsigned char *start = next;
+		int length = 0;
+
+		switch (this_session->mode)
+		{
+		case mode_menu:
+			next = skip_blanks(next, end);
+			start = next;
+			// fall through
+		case mode_query:
+			if (next == end)
+			{
+				return NULL;
+			}
+			bytes[length++] = *next++;
+			feed_commands(this_session, start, 1, out);
+			break;
+		case mode_paused:
+			next = (const unsigned char *)memchr(next, '!', end - next);
+			if (next == NULL)
+			{
+				return NULL;
+			}
+			feed_commands(this_session, start, ++next - start, out);
+			break;
+		case mode_matrix:
+			for (int square = this_session->next_square; square < MATRIX_WIDTH * MATRIX_DEPTH; next++)
+			{
+				if (next == end)
+				{
+					return NULL;
+				}
+				if (!is_blank(*next))
+				{
+					square++;
+				}
+			}
+			feed_commands(this_session, start, next - start, out);
+			pack_squares(this_session->state.main_matrix.squares, bytes);
+			length = PACKED_SQUARES;
+			break;
+		case mode_number:
+			while (next < end && *next >= '0' && *next <= '9')
+			{
+				next++;
+			}
+			if (next == end)
+			{
+				return NULL;
+			}
+			// ended with a blank, so that the byte after the digits is
+			// still read as a command
+			feed_commands(this_session, start, next - start, out);
+			length = put_varint(bytes, this_session->number);
+			feed_commands(this_session, (const unsigned char *)" ", 1, out);
+			break;
+		default:
+			return NULL;
+		}
+
+		append_bytes(&(this_writer->unit), &(this_writer->unit_size), &(this_writer->unit_capacity),
+			bytes, length);
+	}
+
+	return next;
+}
+
+// Feeds back what record_operands kept for the command just fed.
+static bool replay_operands(log_reader *in, session *this_session, output_sink *out)
+{
+	while (this_session->mode != mode_play && this_session->mode != mode_quit)
+	{
+		char text[MATRIX_WIDTH * MATRIX_DEPTH];
+		unsigned long long number;
+		int length;
+
+		switch (this_session->mode)
+		{
+		case mode_query:
+		case mode_menu:
+			if (in->next == in->end)
+			{
+				return false;
+			}
+			feed_commands(this_session, in->next++, 1, out);
+			break;
+		case mode_paused:
+			feed_commands(this_session, (const unsigned char *)"!", 1, out);
+			break;
+		case mode_matrix:
+			if (in->end - in->next < PACKED_SQUARES)
+			{
+				return false;
+			}
+			unpack_squares(in->next, text);
+			in->next += PACKED_SQUARES;
+			feed_commands(this_session, (const unsigned char *)text, sizeof(text), out);
+			break;
+		case mode_number:
+			if (!get_varint(in, &number))
+			{
+				return false;
+			}
+			length = sprintf(text, "%llu ", number);
+			feed_commands(this_session, (const unsigned char *)text, length, out);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Replays moves from in, which is just past checkpoint move or the
+// header, until the game has had until moves or the commands run out.
+// Output to memory is dropped after every move. Returns false if the
+// commands are damaged or end early.
+static bool run_moves(log_reader *in, session *this_session, unsigned long long move,
+	unsigned long long until, output_sink *out)
+{
+	while (move < until)
+	{
+		unsigned long long value, repeats;
+		unsigned char command;
+
+		if (!get_varint(in, &value))
+		{
+			return false;
+		}
+
+		if (value == 0)
+		{
+			if (!get_varint(in, &value) || (unsigned long long)(in->end - in->next) < value)
+			{
+				return false;
+			}
+			in->next += value;
+			continue;
+		}
+
+		if ((value & 0x7f) == 0)
+		{
+			command = (unsigned char)(value >> 7);
+			repeats = 1;
+		}
+		else
+		{
+			command = (unsigned char)(value & 0x7f);
+			repeats = (value >> 7) + 1;
+		}
+
+		for (; repeats > 0 && move < until; repeats--, move++)
+		{
+			feed_commands(this_session, &command, 1, out);
+			if (!replay_operands(in, this_session, out))
+			{
+				return false;
+			}
+			if (out->file == NULL)
+			{
+				out->size = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Records the text commands in script as a log written to file, with a
+// checkpoint every interval moves. A command the script leaves unfinished
+// is not a move; its text is kept as it is and fed after the last move.
+bool record_log(const char *script, size_t size, FILE *file, unsigned long interval)
+{
+	static const unsigned char header[LOG_HEADER_SIZE] = {'L', 'T', 'R', 'L', LOG_VERSION};
+	const unsigned char *next = (const unsigned char *)script;
+	const unsigned char *end = next + size;
+	const unsigned char *unfinished = end;
+	unsigned char trailer[LOG_TRAILER_SIZE];
+	unsigned long long index_offset;
+	log_writer writer;
+	session recorder;
+	output_sink out;
+
+	memset(&writer, 0, sizeof(writer));
+	writer.file = file;
+	writer.interval = interval;
+	init_session(&recorder);
+	init_memory_output(&out);
+	write_bytes(&writer, header, sizeof(header));
+
+	while (recorder.mode != mode_quit)
+	{
+		int command;
+
+		next = skip_blanks(next, end);
+		if (next == end)
+		{
+			break;
+		}
+
+		command = *next;
+		unfinished = next;
+		feed_commands(&recorder, next++, 1, &out);
+		next = record_operands(&writer, &recorder, next, end, &out);
+		if (next == NULL)
+		{
+			break;
+		}
+		unfinished = end;
+
+		write_move(&writer, &recorder, command);
+		out.size = 0;
+	}
+
+	flush_run(&writer);
+	index_offset = writer.offset;
+	write_varint(&writer, writer.moves);
+	write_varint(&writer, writer.interval);
+	write_varint(&writer, writer.checkpoints);
+	write_varint(&writer, end - unfinished);
+	write_bytes(&writer, unfinished, end - unfinished);
+	write_bytes(&writer, writer.index, writer.index_size);
+
+	for (int i = 0; i < 8; i++)
+	{
+		trailer[i] = (unsigned char)(index_offset >> (8 * i));
+	}
+	memcpy(trailer + 8, "LTRX", 4);
+	write_bytes(&writer, trailer, sizeof(trailer));
+
+	free(writer.unit);
+	free(writer.index);
+	free_output(&out);
+	return fflush(file) == 0 && !ferror(file);
+}
+
+bool open_replay_log(replay_log *this_log, const char *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	unsigned long long index_offset = 0;
+	unsigned long long interval, checkpoints, unfinished;
+	log_reader in;
+
+	if (size < LOG_HEADER_SIZE + LOG_TRAILER_SIZE || memcmp(bytes, "LTRL", 4) != 0
+		|| bytes[4] != LOG_VERSION || memcmp(bytes + size - 4, "LTRX", 4) != 0)
+	{
+		return false;
+	}
+
+	for (int i = 7; i >= 0; i--)
+	{
+		index_offset = (index_offset << 8) | bytes[size - LOG_TRAILER_SIZE + i];
+	}
+	if (index_offset < LOG_HEADER_SIZE || index_offset > size - LOG_TRAILER_SIZE)
+	{
+		return false;
+	}
+
+	in.next = bytes + index_offset;
+	in.end = bytes + size - LOG_TRAILER_SIZE;
+	if (!get_varint(&in, &(this_log->moves)) || !get_varint(&in, &interval)
+		|| !get_varint(&in, &checkpoints) || interval == 0 || interval > 0xffffffffu
+		|| checkpoints > this_log->moves / interval || !get_varint(&in, &unfinished)
+		|| unfinished > (unsigned long long)(in.end - in.next))
+	{
+		return false;
+	}
+
+	this_log->data = bytes;
+	this_log->size = size;
+	this_log->commands_start = LOG_HEADER_SIZE;
+	this_log->commands_end = (size_t)index_offset;
+	this_log->interval = (unsigned long)interval;
+	this_log->checkpoints = (unsigned long)checkpoints;
+	this_log->unfinished = in.next - bytes;
+	this_log->unfinished_size = (size_t)unfinished;
+	this_log->offsets = in.next + unfinished - bytes;
+	return true;
+}
+
+// the whole game, printing what it printed
+bool play_log(const replay_log *this_log, session *this_session, output_sink *out)
+{
+	log_reader in;
+
+	in.next = this_log->data + this_log->commands_start;
+	in.end = this_log->data + this_log->commands_end;
+	init_session(this_session);
+	if (!run_moves(&in, this_session, 0, this_log->moves, out))
+	{
+		return false;
+	}
+
+	feed_commands(this_session, this_log->data + this_log->unfinished,
+		this_log->unfinished_size, out);
+	return true;
+}
+
+// The game as it was after move, from the last checkpoint at or before
+// it, printing nothing.
+bool seek_log(const replay_log *this_log, session *this_session, unsigned long long move)
+{
+	unsigned long long checkpoint = 0;
+	unsigned long long reached = 0;
+	unsigned long long offset = 0;
+	unsigned long long value;
+	output_sink out;
+	log_reader in;
+	bool ok;
+
+	if (move > this_log->moves)
+	{
+		return false;
+	}
+
+	in.next = this_log->data + this_log->offsets;
+	in.end = this_log->data + this_log->size - LOG_TRAILER_SIZE;
+	for (; checkpoint < this_log->checkpoints && (checkpoint + 1) * this_log->interval <= move;
+		checkpoint++)
+	{
+		if (!get_varint(&in, &value))
+		{
+			return false;
+		}
+		offset += value;
+	}
+
+	if (checkpoint == 0)
+	{
+		offset = this_log->commands_start;
+	}
+	else if (offset >= this_log->commands_end)
+	{
+		return false;
+	}
+	in.next = this_log->data + offset;
+	in.end = this_log->data + this_log->commands_end;
+
+	if (checkpoint == 0)
+	{
+		init_session(this_session);
+	}
+	else if (!get_varint(&in, &value) || value != 0 || !get_varint(&in, &value)
+		|| !load_checkpoint(&in, this_session))
+	{
+		return false;
+	}
+	else
+	{
+		reached = checkpoint * this_log->interval;
+	}
+
+	init_memory_output(&out);
+	ok = run_moves(&in, this_session, reached, move, &out);
+	free_output(&out);
+	return ok;
+}
+
+int replay_log_main(int argc, char *argv[])
+{
+	if (strcmp(argv[1], "--record") == 0)
+	{
+		return record_main(argc, argv);
+	}
+
+	if (strcmp(argv[1], "--play") == 0)
+	{
+		return play_main(argc, argv);
+	}
+
+	return seek_main(argc, argv);
+}
+
+// --record script log [interval]
+static int record_main(int argc, char *argv[])
+{
+	unsigned long interval = LOG_DEFAULT_INTERVAL;
+	mapped_file script;
+	FILE *file;
+	bool ok;
+
+	if ((argc != 4 && argc != 5) || (argc == 5 && (interval = strtoul(argv[4], NULL, 10)) == 0))
+	{
+		fprintf(stderr, "usage: %s --record script log [interval]\n", argv[0]);
+		return 1;
+	}
+
+	if (!map_file(argv[2], &script))
+	{
+		fprintf(stderr, "cannot open %s\n", argv[2]);
+		return 1;
+	}
+
+	file = fopen(argv[3], "wb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "cannot create %s\n", argv[3]);
+		unmap_file(&script);
+		return 1;
+	}
+
+	setvbuf(file, NULL, _IOFBF, LOG_BUFFER_SIZE);
+	ok = record_log(script.data, script.size, file, interval);
+	ok = (fclose(file) == 0) && ok;
+	unmap_file(&script);
+
+	if (!ok)
+	{
+		fprintf(stderr, "cannot write %s\n", argv[3]);
+		return 1;
+	}
+	return 0;
+}
+
+// --play log: prints what the recorded script printed
+static int play_main(int argc, char *argv[])
+{
+	static char output_buffer[LOG_BUFFER_SIZE];
+	static session player;
+	mapped_file log_file;
+	replay_log log;
+	output_sink out;
+	bool ok;
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: %s --play log\n", argv[0]);
+		return 1;
+	}
+
+	if (!map_file(argv[2], &log_file))
+	{
+		fprintf(stderr, "cannot open %s\n", argv[2]);
+		return 1;
+	}
+
+	if (!open_replay_log(&log, log_file.data, log_file.size))
+	{
+		fprintf(stderr, "%s is not a replay log\n", argv[2]);
+		unmap_file(&log_file);
+		return 1;
+	}
+
+	setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+	init_file_output(&out, stdout);
+	ok = play_log(&log, &player, &out);
+	fflush(stdout);
+	unmap_file(&log_file);
+
+	if (!ok)
+	{
+		fprintf(stderr, "%s is damaged\n", argv[2]);
+		return 1;
+	}
+	return 0;
+}
+
+// --seek log move: the game after move, then the text protocol from
+// stdin carries on from there
+static int seek_main(int argc, char *argv[])
+{
+	static unsigned char input_block[INPUT_BLOCK_SIZE];
+	static session player;
+	command_source source;
+	mapped_file log_file;
+	replay_log log;
+	output_sink out;
+	unsigned long move = 0;
+	char *end = NULL;
+
+	if (argc == 4)
+	{
+		move = strtoul(argv[3], &end, 10);
+	}
+
+	if (end == NULL || end == argv[3] || *end != '\0')
+	{
+		fprintf(stderr, "usage: %s --seek log move\n", argv[0]);
+		return 1;
+	}
+
+	if (!map_file(argv[2], &log_file))
+	{
+		fprintf(stderr, "cannot open %s\n", argv[2]);
+		return 1;
+	}
+
+	if (!open_replay_log(&log, log_file.data, log_file.size))
+	{
+		fprintf(stderr, "%s is not a replay log\n", argv[2]);
+		unmap_file(&log_file);
+		return 1;
+	}
+
+	if (!seek_log(&log, &player, move))
+	{
+		if (move > log.moves)
+		{
+			fprintf(stderr, "%s has %llu moves\n", argv[2], log.moves);
+		}
+		else
+		{
+			fprintf(stderr, "%s is damaged\n", argv[2]);
+		}
+		unmap_file(&log_file);
+		return 1;
+	}
+	unmap_file(&log_file);
+
+	init_stdin_source(&source, input_block, sizeof(input_block));
+	init_file_output(&out, stdout);
+	while (player.mode != mode_quit
+		&& (source.next < source.end || refill_source(&source)))
+	{
+		source.next += feed_commands(&player, source.next, source.end - source.next, &out);
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef LEARNTRIS_REPLAY_LOG_H
+#define LEARNTRIS_REPLAY_LOG_H
+
+#include <stddef.h>
+#include "frontend.h"
+
+// moves between two checkpoints unless --record is given another number
+#define LOG_DEFAULT_INTERVAL 4096
+
+// A recorded game, in a compact binary form of the text protocol:
+//
+//   header     "LTRL", version
+//   commands   a varint per move, (repeats - 1) << 7 | command byte,
+//              then whatever the command reads after it: the byte
+//              after '?' or in the menu, the number after 'R' or '+'
+//              as a varint, the squares after 'g' as 3 bits each
+//   checkpoint a varint 0 and a length, then the whole game after every
+//              interval moves: matrix, piece, bag, undo history
+//   index      moves, interval, checkpoints, the text of a command the
+//              script left unfinished as a length and bytes, and the
+//              offset of each checkpoint from the one before
+//   trailer    the offset of the index as 8 bytes, then "LTRX"
+//
+// A move is one command with what it reads, so move n is the game after
+// the first n commands of the script. A command still waiting for what it
+// reads when the script ends, such as a pause never closed with '!', is
+// not a move; --play feeds its text as it is after the last move, so the
+// output matches the script's. Commands above 127 are written as
+// a varint of the byte << 7, with no repeats. Replaying feeds every move
+// back through feed_commands, so it runs the same engine code the
+// script did, and seeking only replays from the checkpoint before.
+typedef struct tag_replay_log
+{
+	const unsigned char *data;
+	size_t size;
+	size_t commands_start;
+	size_t commands_end;		// where the index starts
+	unsigned long long moves;
+	unsigned long interval;
+	unsigned long checkpoints;
+	size_t unfinished;			// where the unfinished command's text starts
+	size_t unfinished_size;
+	size_t offsets;				// where the checkpoint offsets start
+} replay_log;
+
+bool record_log(const char *script, size_t size, FILE *file, unsigned long interval);
+bool open_replay_log(replay_log *this_log, const char *data, size_t size);
+bool play_log(const replay_log *this_log, session *this_session, output_sink *out);
+bool seek_log(const replay_log *this_log, session *this_session, unsigned long long move);
+int replay_log_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+
+#define MAX_BEAM_WIDTH 16
+#define MAX_SEARCH_LINES (SEARCH_MAX_DEPTH * 4)
+
+typedef struct tag_search_child
+{
+	game_state state;
+	placement move;
+	int score;
+	int lines;
+} search_child;
+
+const evaluator_weights default_weights = { 51, 36, 18, 76 };
+
+const search_config default_search_config =
+{
+	3,
+	8,
+	standard_evaluator,
+	&default_weights
+};
+
+// Zobrist keys, one per row and per byte of the row word, so that a row
+// hashes with two lookups. ply_keys and lines_keys tell apart the same
+// board reached at different depths or with different lines cleared.
+static board_hash row_keys[MATRIX_DEPTH][2][256];
+static board_hash ply_keys[SEARCH_MAX_DEPTH];
+static board_hash lines_keys[MAX_SEARCH_LINES + 1];
+
+static board_hash next_key(board_hash *state);
+static bool init_keys();
+static board_hash row_key(int row, row_bitfield bits);
+static transposition_entry *find_entry(search_context *this_search, board_hash key);
+static int search_node(search_context *this_search, game_state *node, board_hash hash,
+	int ply, int count, const int *pieces, int lines);
+
+static board_hash next_key(board_hash *state)
+{
+	board_hash z;
+
+	*state += 0x9E3779B97F4A7C15ULL;
+	z = *state;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Fixed seed, so hashes are the same in every run and on every thread.
+// Runs once, while the program starts and before any thread exists.
+static bool init_keys()
+{
+	board_hash state = 0x4C6561726E747269ULL;
+	board_hash squares[MATRIX_DEPTH][16];
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		for (int col = 0; col < 16; col++)
+		{
+			squares[row][col] = next_key(&state);
+		}
+
+		for (int half = 0; half < 2; half++)
+		{
+			for (int value = 0; value < 256; value++)
+			{
+				board_hash key = 0;
+
+				for (int bit = 0; bit < 8; bit++)
+				{
+					if ((value & (1 << bit)) != 0)
+					{
+						key ^= squares[row][8 * half + bit];
+					}
+				}
+				row_keys[row][half][value] = key;
+			}
+		}
+	}
+
+	for (int ply = 0; ply < SEARCH_MAX_DEPTH; ply++)
+	{
+		ply_keys[ply] = next_key(&state);
+	}
+
+	for (int lines = 0; lines <= MAX_SEARCH_LINES; lines++)
+	{
+		lines_keys[lines] = next_key(&state);
+	}
+
+	return true;
+}
+
+static const bool keys_ready = init_keys();
+
+static board_hash row_key(int row, row_bitfield bits)
+{
+	return row_keys[row][0][bits & 0xff] ^ row_keys[row][1][bits >> 8];
+}
+
+board_hash hash_board(matrix *this_matrix)
+{
+	board_hash hash = 0;
+
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		hash ^= row_key(row, this_matrix->rows[row]);
+	}
+
+	return hash;
+}
+
+// only the rows that changed between the two boards are rehashed
+board_hash update_hash(board_hash hash, matrix *before, matrix *after)
+{
+	for (int row = 0; row < MATRIX_DEPTH; row++)
+	{
+		if (before->rows[row] != after->rows[row])
+		{
+			hash ^= row_key(row, before->rows[row]) ^ row_key(row, after->rows[row]);
+		}
+	}
+
+	return hash;
+}
+
+int standard_evaluator(matrix *this_matrix, int lines_cleared, const void *settings)
+{
+	const evaluator_weights *weights = (const evaluator_weights *)settings;
+	int aggregate = 0, holes = 0, bumpiness = 0;
+	int previous = 0;
+
+	for (int col = 0; col < MATRIX_WIDTH; col++)
+	{
+		int height = column_height(this_matrix, col);
+
+		// every empty square under the surface is a hole
+		aggregate += height;
+		holes += height - count_bits(this_matrix->columns[col]);
+		if (col > 0)
+		{
+			bumpiness += abs(height - previous);
+		}
+		previous = height;
+	}
+
+	return weights->lines * lines_cleared - weights->height * aggregate
+		- weights->holes * holes - weights->bumpiness * bumpiness;
+}
+
+bool init_search(search_context *this_search, const search_config *config, int table_bits)
+{
+	this_search->config = *config;
+	if (this_search->config.depth > SEARCH_MAX_DEPTH)
+	{
+		this_search->config.depth = SEARCH_MAX_DEPTH;
+	}
+	if (this_search->config.beam_width > MAX_BEAM_WIDTH)
+	{
+		this_search->config.beam_width = MAX_BEAM_WIDTH;
+	}
+
+	this_search->table = (transposition_entry *)calloc(
+		(size_t)1 << table_bits, sizeof(transposition_entry));
+	this_search->table_mask = ((board_hash)1 << table_bits) - 1;
+	this_search->generation = 0;
+	this_search->nodes = 0;
+	this_search->hits = 0;
+
+	return this_search->table != NULL;
+}
+
+void free_search(search_context *this_search)
+{
+	free(this_search->table);
+	this_search->table = NULL;
+}
+
+static transposition_entry *find_entry(search_context *this_search, board_hash key)
+{
+	return this_search->table + (key & this_search->table_mask);
+}
+
+// Returns the value of the best line of play from node, whose active
+// tetromino is pieces[ply]. The best move is left in the table entry.
+static int search_node(search_context *this_search, game_state *node, board_hash hash,
+	int ply, int count, const int *pieces, int lines)
+{
+	placement placements[MAX_PLACEMENTS];
+	search_child beam[MAX_BEAM_WIDTH];
+	int beam_width = this_search->config.beam_width;
+	int kept = 0, num_placements, best_value = SEARCH_LOSS;
+	placement best_move;
+	board_hash key;
+	transposition_entry *entry;
+
+	key = hash ^ ply_keys[ply] ^ lines_keys[lines < MAX_SEARCH_LINES ? lines : MAX_SEARCH_LINES];
+	entry = find_entry(this_search, key);
+	if (entry->generation == this_search->generation && entry->key == key)
+	{
+		this_search->hits++;
+		return entry->value;
+	}
+
+	num_placements = find_placements(&(node->main_matrix), &(node->active_tetromino), placements);
+	best_move.position = -1;
+	best_move.top = -1;
+	best_move.left = -1;
+
+	// keep the beam_width best children, sorted best first
+	for (int i = 0; i < num_placements; i++)
+	{
+		search_child child;
+		int slot;
+
+		child.state = *node;
+		child.move = placements[i];
+		if (!play_placement(&(child.state), placements + i))
+		{
+			continue;
+		}
+
+		exec_step(&(child.state));
+		child.lines = lines + child.state.num_lines - node->num_lines;
+		child.score = this_search->config.evaluator(&(child.state.main_matrix),
+			child.lines, this_search->config.evaluator_settings);
+		this_search->nodes++;
+
+		if (kept == beam_width && child.score <= beam[kept - 1].score)
+		{
+			continue;
+		}
+
+		slot = (kept < beam_width) ? kept++ : kept - 1;
+		for (; slot > 0 && beam[slot - 1].score < child.score; slot--)
+		{
+			beam[slot] = beam[slot - 1];
+		}
+		beam[slot] = child;
+	}
+
+	for (int i = 0; i < kept; i++)
+	{
+		search_child *child = beam + i;
+		int value = child->score;
+
+		if (ply + 1 < count)
+		{
+			if (spawn_tetromino(&(child->state.active_tetromino), pieces[ply + 1],
+					&(child->state.main_matrix)))
+			{
+				value = search_node(this_search, &(child->state),
+					update_hash(hash, &(node->main_matrix), &(child->state.main_matrix)),
+					ply + 1, count, pieces, child->lines);
+			}
+			else
+			{
+				value = SEARCH_LOSS;
+			}
+		}
+
+		if (best_move.position < 0 || value > best_value)
+		{
+			best_value = value;
+			best_move = child->move;
+		}
+	}
+
+	entry->key = key;
+	entry->value = best_value;
+	entry->generation = this_search->generation;
+	entry->best = best_move;
+
+	return best_value;
+}
+
+// Looks ahead through the active tetromino and the preview, and fills
+// moves with the best sequence of placements found, moves[0] being the
+// one for the active tetromino. Returns how many moves were filled in,
+// 0 if the active tetromino has nowhere to go.
+int find_best_moves(search_context *this_search, game_state *this_game_state,
+	const int *preview, int preview_length, placement *moves)
+{
+	int pieces[SEARCH_MAX_DEPTH];
+	int count = this_search->config.depth;
+	int lines = 0, found = 0;
+	board_hash hash;
+	game_state line_state;
+
+	if (this_game_state->active_tetromino.type == illegal_tetromino)
+	{
+		return 0;
+	}
+
+	if (count > preview_length + 1)
+	{
+		count = preview_length + 1;
+	}
+
+	pieces[0] = this_game_state->active_tetromino.type;
+	for (int i = 1; i < count; i++)
+	{
+		pieces[i] = preview[i - 1];
+	}
+
+	// a new generation empties the table without touching it
+	if (++this_search->generation == 0)
+	{
+		memset(this_search->table, 0,
+			(size_t)(this_search->table_mask + 1) * sizeof(transposition_entry));
+		this_search->generation = 1;
+	}
+	this_search->nodes = 0;
+	this_search->hits = 0;
+
+	hash = hash_board(&(this_game_state->main_matrix));
+	search_node(this_search, this_game_state, hash, 0, count, pieces, 0);
+
+	// follow the best moves stored in the table to recover the line
+	line_state = *this_game_state;
+	while (found < count)
+	{
+		board_hash key = hash ^ ply_keys[found]
+			^ lines_keys[lines < MAX_SEARCH_LINES ? lines : MAX_SEARCH_LINES];
+		transposition_entry *entry = find_entry(this_search, key);
+		matrix before;
+
+		if (entry->generation != this_search->generation || entry->key != key
+			|| entry->best.position < 0)
+		{
+			break;
+		}
+
+		moves[found++] = entry->best;
+		before = line_state.main_matrix;
+		lines -= line_state.num_lines;
+		if (!play_placement(&line_state, &(entry->best)))
+		{
+			break;
+		}
+		exec_step(&line_state);
+		lines += line_state.num_lines;
+		hash = update_hash(hash, &before, &(line_state.main_matrix));
+
+		if (found < count && !spawn_tetromino(&(line_state.active_tetromino),
+				pieces[found], &(line_state.main_matrix)))
+		{
+			break;
+		}
+	}
+
+	return found;
+}
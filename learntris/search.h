@@ -0,0 +1,61 @@
+#ifndef LEARNTRIS_SEARCH_H
+#define LEARNTRIS_SEARCH_H
+
+#include "learntris.h"
+
+#define SEARCH_MAX_DEPTH 8
+#define SEARCH_LOSS (-1000000000)
+#define SEARCH_DEFAULT_TABLE_BITS 16
+
+typedef unsigned long long board_hash;
+
+// Scores a board, higher is better. lines_cleared is the number of
+// lines cleared on the way there.
+typedef int (*board_evaluator)(matrix *this_matrix, int lines_cleared, const void *settings);
+
+typedef struct tag_evaluator_weights
+{
+	int height;		// per square of aggregate column height
+	int holes;		// per empty square with a block above it
+	int bumpiness;	// per square of height difference between neighbours
+	int lines;		// per line cleared
+} evaluator_weights;
+
+typedef struct tag_search_config
+{
+	int depth;			// pieces to look ahead, the active one included
+	int beam_width;		// best children expanded at every node
+	board_evaluator evaluator;
+	const void *evaluator_settings;
+} search_config;
+
+typedef struct tag_transposition_entry
+{
+	board_hash key;
+	int value;
+	unsigned int generation;
+	placement best;
+} transposition_entry;
+
+typedef struct tag_search_context
+{
+	search_config config;
+	transposition_entry *table;
+	board_hash table_mask;
+	unsigned int generation;
+	long nodes;		// boards evaluated by the last search
+	long hits;		// transposition table hits in the last search
+} search_context;
+
+extern const evaluator_weights default_weights;
+extern const search_config default_search_config;
+
+int standard_evaluator(matrix *this_matrix, int lines_cleared, const void *settings);
+board_hash hash_board(matrix *this_matrix);
+board_hash update_hash(board_hash hash, matrix *before, matrix *after);
+bool init_search(search_context *this_search, const search_config *config, int table_bits);
+void free_search(search_context *this_search);
+int find_best_moves(search_context *this_search, game_state *this_game_state,
+	const int *preview, int preview_length, placement *moves);
+
+#endif
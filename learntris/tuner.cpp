@@ -0,0 +1,303 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tuner.h"
+
+#define TUNE_PI 3.14159265358979323846
+
+typedef struct tag_tune_candidate
+{
+	feature_weights weights;
+	double lines;
+} tune_candidate;
+
+static double next_uniform(random_state *random);
+static double next_normal(random_state *random);
+static int compare_candidates(const void *a, const void *b);
+static void print_weights(FILE *file, const feature_weights *weights);
+static void print_generation(FILE *file, int generation, double seconds,
+	const tune_candidate *candidates, int population, const feature_weights *mean);
+static int tune_usage(const char *program);
+
+// in (0, 1), never 0 so that it can be logged
+static double next_uniform(random_state *random)
+{
+	return (next_random(random, 1u << 30) + 0.5) / (double)(1u << 30);
+}
+
+// Box-Muller, throwing away the second value
+static double next_normal(random_state *random)
+{
+	double radius = sqrt(-2.0 * log(next_uniform(random)));
+
+	return radius * cos(2.0 * TUNE_PI * next_uniform(random));
+}
+
+// most lines first
+static int compare_candidates(const void *a, const void *b)
+{
+	double left = ((const tune_candidate *)a)->lines;
+	double right = ((const tune_candidate *)b)->lines;
+
+	return (left < right) - (left > right);
+}
+
+// as --batch --weights reads them
+static void print_weights(FILE *file, const feature_weights *weights)
+{
+	for (int kind = 0; kind < feature_count; kind++)
+	{
+		fprintf(file, (kind == 0) ? "%d" : ",%d", weights->values[kind]);
+	}
+}
+
+static void print_generation(FILE *file, int generation, double seconds,
+	const tune_candidate *candidates, int population, const feature_weights *mean)
+{
+	double total = 0.0;
+
+	for (int i = 0; i < population; i++)
+	{
+		total += candidates[i].lines;
+	}
+
+	fprintf(file, "generation %d: seconds %.2f lines best %.2f mean %.2f best ", generation,
+		seconds, candidates[0].lines, total / population);
+	print_weights(file, &(candidates[0].weights));
+	fprintf(file, " mean ");
+	print_weights(file, mean);
+	fprintf(file, "\n");
+	fflush(file);
+}
+
+// Writes a line per generation to log, and to stdout as well. Returns
+// false if the games couldn't be run.
+bool tune_weights(const tune_config *config, FILE *log, tune_result *result)
+{
+	double mean[feature_count], deviation[feature_count];
+	const void **settings;
+	tune_candidate *candidates;
+	game_result *results;
+	batch_config batch;
+	random_state random = seed_random(config->seed, 0);
+	bool ok = true;
+
+	candidates = (tune_candidate *)malloc(config->population * sizeof(tune_candidate));
+	settings = (const void **)malloc(config->population * sizeof(const void *));
+	results = (game_result *)malloc(config->population * config->games * sizeof(game_result));
+	if (candidates == NULL || settings == NULL || results == NULL)
+	{
+		free(candidates);
+		free(settings);
+		free(results);
+		return false;
+	}
+
+	for (int kind = 0; kind < feature_count; kind++)
+	{
+		mean[kind] = default_feature_weights.values[kind];
+		deviation[kind] = TUNE_INITIAL_DEVIATION;
+	}
+
+	batch.games = config->population * config->games;
+	batch.threads = config->threads;
+	batch.max_pieces = config->max_pieces;
+	batch.policy = features_policy;
+	batch.policy_settings = NULL;
+	batch.settings_list = settings;
+	batch.games_per_settings = config->games;
+
+	result->best_lines = -1.0;
+	result->seconds = 0.0;
+
+	for (int generation = 1; generation <= config->generations && ok; generation++)
+	{
+		double seconds;
+
+		for (int i = 0; i < config->population; i++)
+		{
+			for (int kind = 0; kind < feature_count; kind++)
+			{
+				candidates[i].weights.values[kind] =
+					(int)floor(mean[kind] + deviation[kind] * next_normal(&random) + 0.5);
+			}
+			settings[i] = &(candidates[i].weights);
+		}
+
+		// new games every generation, the same ones for every candidate
+		batch.seed = config->seed + generation;
+		seconds = run_batch(&batch, results);
+		if (seconds < 0.0)
+		{
+			ok = false;
+			break;
+		}
+		result->seconds += seconds;
+
+		for (int i = 0; i < config->population; i++)
+		{
+			long lines = 0;
+
+			for (long game = 0; game < config->games; game++)
+			{
+				lines += results[i * config->games + game].num_lines;
+			}
+			candidates[i].lines = (double)lines / config->games;
+		}
+
+		// the settings point into candidates, so sort after the games
+		qsort(candidates, config->population, sizeof(tune_candidate), compare_candidates);
+		if (candidates[0].lines > result->best_lines)
+		{
+			result->best = candidates[0].weights;
+			result->best_lines = candidates[0].lines;
+		}
+
+		for (int kind = 0; kind < feature_count; kind++)
+		{
+			double sum = 0.0, squares = 0.0;
+
+			for (int i = 0; i < config->elite; i++)
+			{
+				sum += candidates[i].weights.values[kind];
+			}
+			mean[kind] = sum / config->elite;
+
+			for (int i = 0; i < config->elite; i++)
+			{
+				double difference = candidates[i].weights.values[kind] - mean[kind];
+
+				squares += difference * difference;
+			}
+			deviation[kind] = sqrt(squares / config->elite + TUNE_NOISE / generation);
+			result->weights.values[kind] = (int)floor(mean[kind] + 0.5);
+		}
+
+		print_generation(log, generation, seconds, candidates, config->population, &(result->weights));
+		if (log != stdout)
+		{
+			print_generation(stdout, generation, seconds, candidates, config->population,
+				&(result->weights));
+		}
+	}
+
+	free(candidates);
+	free(settings);
+	free(results);
+	return ok;
+}
+
+static int tune_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s --tune [--generations n] [--population n] [--elite n]"
+		" [--games n] [--pieces n] [--seed n] [--threads n] [--out file]\n", program);
+	return 1;
+}
+
+// learntris --tune [--generations n] [--population n] [--elite n] [--games n]
+//   [--pieces n] [--seed n] [--threads n] [--out file]
+int tune_main(int argc, char *argv[])
+{
+	tune_config config;
+	tune_result result;
+	const char *path = "tune.txt";
+	FILE *log;
+	bool ok;
+
+	config.generations = TUNE_DEFAULT_GENERATIONS;
+	config.population = TUNE_DEFAULT_POPULATION;
+	config.elite = TUNE_DEFAULT_ELITE;
+	config.games = TUNE_DEFAULT_GAMES;
+	config.max_pieces = TUNE_DEFAULT_PIECES;
+	config.seed = 1;
+	config.threads = 0;
+
+	for (int i = 2; i < argc; i += 2)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (value == NULL)
+		{
+			return tune_usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--generations") == 0)
+		{
+			config.generations = atoi(value);
+		}
+		else if (strcmp(argv[i], "--population") == 0)
+		{
+			config.population = atoi(value);
+		}
+		else if (strcmp(argv[i], "--elite") == 0)
+		{
+			config.elite = atoi(value);
+		}
+		else if (strcmp(argv[i], "--games") == 0)
+		{
+			config.games = atol(value);
+		}
+		else if (strcmp(argv[i], "--pieces") == 0)
+		{
+			config.max_pieces = atoi(value);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			config.seed = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			config.threads = atoi(value);
+		}
+		else if (strcmp(argv[i], "--out") == 0)
+		{
+			path = value;
+		}
+		else
+		{
+			return tune_usage(argv[0]);
+		}
+	}
+
+	if (config.generations <= 0 || config.population <= 0 || config.games <= 0
+		|| config.max_pieces <= 0 || config.elite <= 0 || config.elite > config.population)
+	{
+		fprintf(stderr, "generations, population, games and pieces must be positive,"
+			" and elite from 1 to the population\n");
+		return 1;
+	}
+
+	log = fopen(path, "w");
+	if (log == NULL)
+	{
+		fprintf(stderr, "cannot create %s\n", path);
+		return 1;
+	}
+
+	fprintf(log, "tune: generations %d population %d elite %d games %ld pieces %d seed %lu\n",
+		config.generations, config.population, config.elite, config.games, config.max_pieces,
+		config.seed);
+	fprintf(log, "features: height,holes,bumpiness,row transitions,column transitions,wells,lines\n");
+
+	ok = tune_weights(&config, log, &result);
+	if (ok)
+	{
+		fprintf(log, "seconds: %.2f\n", result.seconds);
+		fprintf(log, "best: lines %.2f weights ", result.best_lines);
+		print_weights(log, &(result.best));
+		fprintf(log, "\nweights: ");
+		print_weights(log, &(result.weights));
+		fprintf(log, "\n");
+
+		printf("weights: ");
+		print_weights(stdout, &(result.weights));
+		printf("\n");
+	}
+	ok = (fclose(log) == 0) && ok;
+
+	if (!ok)
+	{
+		fprintf(stderr, "tuning failed, or %s couldn't be written\n", path);
+		return 1;
+	}
+	return 0;
+}
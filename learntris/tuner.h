@@ -0,0 +1,46 @@
+#ifndef LEARNTRIS_TUNER_H
+#define LEARNTRIS_TUNER_H
+
+#include <stdio.h>
+#include "batch.h"
+#include "evaluator.h"
+
+#define TUNE_DEFAULT_GENERATIONS 20
+#define TUNE_DEFAULT_POPULATION 32
+#define TUNE_DEFAULT_ELITE 8
+#define TUNE_DEFAULT_GAMES 16
+#define TUNE_DEFAULT_PIECES 500
+#define TUNE_INITIAL_DEVIATION 25.0
+// variance added back to every feature after a generation, divided by
+// the generation number, so the spread doesn't collapse too early
+#define TUNE_NOISE 16.0
+
+// Tunes the feature_weights of features_policy with the cross-entropy
+// method. Each generation draws a population of weight vectors from a
+// normal distribution per feature and plays the same seeded games with
+// every one of them. All the games of a generation are a single batch
+// across every core. The distribution is then refit to the elite, the
+// vectors that cleared the most lines on average.
+typedef struct tag_tune_config
+{
+	int generations;
+	int population;
+	int elite;
+	long games;				// per vector per generation
+	int max_pieces;			// per game
+	unsigned long seed;
+	int threads;			// 0 means one per cpu
+} tune_config;
+
+typedef struct tag_tune_result
+{
+	feature_weights weights;	// the mean of the last distribution
+	feature_weights best;		// the single best vector played
+	double best_lines;			// its mean lines in its generation
+	double seconds;
+} tune_result;
+
+bool tune_weights(const tune_config *config, FILE *log, tune_result *result);
+int tune_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "versus.h"
+
+// garbage rows sent for 0 to 4 lines cleared by one piece
+static const int garbage_rows[TETROMINO_SIZE + 1] = { 0, 0, 1, 2, 4 };
+
+// --versus runs matches on this many pairs of threads
+typedef struct tag_versus_worker
+{
+	const versus_config *config;
+	versus_result *results;
+	long matches;
+	int index;
+	int num_workers;
+	thread_handle thread;
+	bool started;
+	bool paired;
+	search_context searches[VERSUS_PLAYERS];
+	versus_pair pair;
+} versus_worker;
+
+static void send_garbage(versus_player *this_player, int rows);
+static int receive_garbage(versus_player *this_player);
+static void player_main(versus_player *this_player);
+static void opponent_main(void *argument);
+static void worker_main(void *argument);
+static int versus_usage(const char *program);
+
+// Waits for room while the opponent is a whole queue behind, unless it
+// has stopped and will never read again; then the message is dropped.
+static void send_garbage(versus_player *this_player, int rows)
+{
+	garbage_queue *queue = this_player->outbox;
+	long written = queue->written;
+
+	while (written - load_acquire(&(queue->read)) == GARBAGE_QUEUE_SIZE)
+	{
+		if (load_acquire(this_player->opponent_stopped) != 0)
+		{
+			return;
+		}
+		yield_thread();
+	}
+
+	queue->messages[written & (GARBAGE_QUEUE_SIZE - 1)].rows = rows;
+	store_release(&(queue->written), written + 1);
+}
+
+// The opponent's next message, waiting for it if need be. An opponent
+// only stops after sending every message this side will ask for: up to
+// its GARBAGE_OVER, or up to its last piece, which is at least delay
+// pieces past the last one this side reads.
+static int receive_garbage(versus_player *this_player)
+{
+	garbage_queue *queue = this_player->inbox;
+	long read = queue->read;
+	int rows;
+
+	while (load_acquire(&(queue->written)) == read)
+	{
+		yield_thread();
+	}
+
+	rows = queue->messages[read & (GARBAGE_QUEUE_SIZE - 1)].rows;
+	store_release(&(queue->read), read + 1);
+	return rows;
+}
+
+// Plays pieces until the player can't, the opponent's GARBAGE_OVER
+// arrives, or max_pieces; a message goes out after every piece.
+static void player_main(versus_player *this_player)
+{
+	const versus_config *config = this_player->config;
+	random_state match_random = seed_random(config->seed, this_player->match);
+	game_state my_game_state;
+	policy_context context;
+	placement choice;
+	piece_bag pieces;
+	random_state holes;
+	int upcoming[BATCH_PREVIEW_LENGTH];
+
+	// both players are dealt the same pieces and holes, and each has
+	// its own stream for the policy
+	init_bag(&pieces, split_random(&match_random), BATCH_PREVIEW_LENGTH);
+	holes = split_random(&match_random);
+	for (int i = 0; i <= this_player->index; i++)
+	{
+		context.random = split_random(&match_random);
+	}
+
+	init(&my_game_state);
+	context.settings = config->policy_settings[this_player->index];
+	context.preview = upcoming;
+	context.preview_length = BATCH_PREVIEW_LENGTH;
+	context.search = this_player->search;
+
+	this_player->lost_at = -1;
+	this_player->garbage_sent = 0;
+	this_player->result.pieces = 0;
+
+	for (int piece = 0; piece < config->max_pieces; piece++)
+	{
+		int lines = my_game_state.num_lines;
+		int rows;
+
+		if (piece >= config->delay)
+		{
+			rows = receive_garbage(this_player);
+			if (rows == GARBAGE_OVER)
+			{
+				break;
+			}
+
+			if (rows > 0 && !insert_garbage(&(my_game_state.main_matrix), rows,
+				next_random(&holes, MATRIX_WIDTH), GARBAGE_COLOR))
+			{
+				this_player->lost_at = piece;
+				break;
+			}
+		}
+
+		my_game_state.active_tetromino.type = next_piece(&pieces);
+		for (int i = 0; i < BATCH_PREVIEW_LENGTH; i++)
+		{
+			upcoming[i] = peek_piece(&pieces, i);
+		}
+
+		if (!spawn_tetromino(&(my_game_state.active_tetromino), my_game_state.active_tetromino.type,
+				&(my_game_state.main_matrix))
+			|| !config->policies[this_player->index](&my_game_state, &context, &choice)
+			|| !play_placement(&my_game_state, &choice))
+		{
+			this_player->lost_at = piece;
+			break;
+		}
+
+		exec_step(&my_game_state);
+		this_player->result.pieces++;
+
+		lines = my_game_state.num_lines - lines;
+		rows = garbage_rows[(lines < TETROMINO_SIZE) ? lines : TETROMINO_SIZE];
+		this_player->garbage_sent += rows;
+		send_garbage(this_player, rows);
+	}
+
+	if (this_player->lost_at >= 0)
+	{
+		send_garbage(this_player, GARBAGE_OVER);
+	}
+
+	this_player->result.score = my_game_state.score;
+	this_player->result.num_lines = my_game_state.num_lines;
+	store_release(this_player->stopped, 1);
+}
+
+// Player 1's thread: every match posted, until stop_pair.
+static void opponent_main(void *argument)
+{
+	versus_pair *this_pair = (versus_pair *)argument;
+	long played = 0;
+
+	for (;;)
+	{
+		while (load_acquire(&(this_pair->posted)) == played)
+		{
+			yield_thread();
+		}
+
+		if (this_pair->quit)
+		{
+			return;
+		}
+
+		player_main(this_pair->players + 1);
+		store_release(&(this_pair->finished), ++played);
+	}
+}
+
+// Starts player 1's thread, which plays every match of the pair until
+// stop_pair; searches has a search context, or NULL, for each player.
+// Returns false if the thread couldn't be started.
+bool start_pair(versus_pair *this_pair, const versus_config *config, search_context **searches)
+{
+	for (int i = 0; i < VERSUS_PLAYERS; i++)
+	{
+		this_pair->players[i].config = config;
+		this_pair->players[i].index = i;
+		this_pair->players[i].search = searches[i];
+		this_pair->players[i].outbox = this_pair->queues + i;
+		this_pair->players[i].inbox = this_pair->queues + (1 - i);
+		this_pair->players[i].stopped = this_pair->stopped + i;
+		this_pair->players[i].opponent_stopped = this_pair->stopped + (1 - i);
+	}
+
+	this_pair->posted = 0;
+	this_pair->finished = 0;
+	this_pair->quit = false;
+	return start_thread(&(this_pair->thread), opponent_main, this_pair);
+}
+
+// Plays one match, player 0 on the calling thread while player 1's
+// thread plays the other side. The player who couldn't play a piece
+// first loses.
+void play_match(versus_pair *this_pair, long match, versus_result *result)
+{
+	versus_player *players = this_pair->players;
+	long posted = this_pair->posted;
+	int lost[VERSUS_PLAYERS];
+
+	// player 1 is done with the last match, so nothing else touches these
+	memset(this_pair->queues, 0, sizeof(this_pair->queues));
+	for (int i = 0; i < VERSUS_PLAYERS; i++)
+	{
+		this_pair->stopped[i] = 0;
+		players[i].match = match;
+	}
+
+	store_release(&(this_pair->posted), posted + 1);
+	player_main(players);
+	while (load_acquire(&(this_pair->finished)) != posted + 1)
+	{
+		yield_thread();
+	}
+
+	for (int i = 0; i < VERSUS_PLAYERS; i++)
+	{
+		result->players[i] = players[i].result;
+		result->garbage_sent[i] = players[i].garbage_sent;
+		// never losing is the same as losing after the last piece
+		lost[i] = (players[i].lost_at >= 0) ? players[i].lost_at : players[i].config->max_pieces;
+	}
+
+	result->winner = (lost[0] == lost[1]) ? -1 : (lost[0] > lost[1]) ? 0 : 1;
+}
+
+void stop_pair(versus_pair *this_pair)
+{
+	this_pair->quit = true;
+	store_release(&(this_pair->posted), this_pair->posted + 1);
+	join_thread(&(this_pair->thread));
+}
+
+// every num_workers-th match, starting at index
+static void worker_main(void *argument)
+{
+	versus_worker *this_worker = (versus_worker *)argument;
+
+	for (long match = this_worker->index; match < this_worker->matches;
+		match += this_worker->num_workers)
+	{
+		play_match(&(this_worker->pair), match, this_worker->results + match);
+	}
+}
+
+static int versus_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s --versus <matches> [--seed n] [--delay n] [--pieces n]"
+		" [--policy name] [--opponent name]\n", program);
+	return 1;
+}
+
+// learntris --versus <matches> [--seed n] [--delay n] [--pieces n]
+//   [--policy name] [--opponent name]
+int versus_main(int argc, char *argv[])
+{
+	versus_config config;
+	versus_result *results;
+	versus_worker *workers;
+	search_context *searches[VERSUS_PLAYERS];
+	const char *names[VERSUS_PLAYERS] = { "lookahead", "greedy" };
+	long matches, draws = 0;
+	int num_workers;
+	bool ok = true;
+	double seconds;
+
+	if (argc < 3 || atol(argv[2]) <= 0)
+	{
+		return versus_usage(argv[0]);
+	}
+
+	matches = atol(argv[2]);
+	config.seed = 1;
+	config.delay = VERSUS_DEFAULT_DELAY;
+	config.max_pieces = BATCH_DEFAULT_MAX_PIECES;
+	config.policy_settings[0] = NULL;
+	config.policy_settings[1] = NULL;
+
+	for (int i = 3; i < argc; i += 2)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (value == NULL)
+		{
+			return versus_usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			config.seed = strtoul(value, NULL, 10);
+		}
+		else if (strcmp(argv[i], "--delay") == 0)
+		{
+			config.delay = atoi(value);
+		}
+		else if (strcmp(argv[i], "--pieces") == 0)
+		{
+			config.max_pieces = atoi(value);
+		}
+		else if (strcmp(argv[i], "--policy") == 0)
+		{
+			names[0] = value;
+		}
+		else if (strcmp(argv[i], "--opponent") == 0)
+		{
+			names[1] = value;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < VERSUS_PLAYERS; i++)
+	{
+		config.policies[i] = find_policy(names[i]);
+		if (config.policies[i] == NULL)
+		{
+			fprintf(stderr, "unknown policy %s\n", names[i]);
+			return 1;
+		}
+	}
+
+	// a player can't wait for a message further back than the queue holds
+	if (config.delay < 1 || config.delay >= GARBAGE_QUEUE_SIZE || config.max_pieces <= 0)
+	{
+		fprintf(stderr, "--delay must be from 1 to %d, and --pieces positive\n",
+			GARBAGE_QUEUE_SIZE - 1);
+		return 1;
+	}
+
+	// a match keeps two threads busy
+	num_workers = count_cpus() / VERSUS_PLAYERS;
+	num_workers = (num_workers < 1) ? 1 : (num_workers > matches) ? (int)matches : num_workers;
+
+	results = (versus_result *)malloc(matches * sizeof(versus_result));
+	workers = (versus_worker *)calloc(num_workers, sizeof(versus_worker));
+	if (results == NULL || workers == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		free(results);
+		free(workers);
+		return 1;
+	}
+
+	for (int i = 0; i < num_workers; i++)
+	{
+		workers[i].config = &config;
+		workers[i].results = results;
+		workers[i].matches = matches;
+		workers[i].index = i;
+		workers[i].num_workers = num_workers;
+		for (int player = 0; player < VERSUS_PLAYERS; player++)
+		{
+			bool ready = init_search(workers[i].searches + player, &default_search_config,
+				SEARCH_DEFAULT_TABLE_BITS);
+
+			searches[player] = ready ? workers[i].searches + player : NULL;
+		}
+		workers[i].paired = start_pair(&(workers[i].pair), &config, searches);
+		ok = ok && workers[i].paired;
+	}
+
+	seconds = seconds_now();
+	for (int i = 1; i < num_workers && ok; i++)
+	{
+		workers[i].started = start_thread(&(workers[i].thread), worker_main, workers + i);
+		ok = ok && workers[i].started;
+	}
+	if (ok)
+	{
+		worker_main(workers);
+	}
+	for (int i = 1; i < num_workers; i++)
+	{
+		if (workers[i].started)
+		{
+			join_thread(&(workers[i].thread));
+		}
+	}
+	seconds = seconds_now() - seconds;
+
+	for (int i = 0; i < num_workers; i++)
+	{
+		if (workers[i].paired)
+		{
+			stop_pair(&(workers[i].pair));
+		}
+		for (int player = 0; player < VERSUS_PLAYERS; player++)
+		{
+			free_search(workers[i].searches + player);
+		}
+	}
+	free(workers);
+
+	if (!ok)
+	{
+		fprintf(stderr, "cannot start the player threads\n");
+		free(results);
+		return 1;
+	}
+
+	printf("matches: %ld\n", matches);
+	printf("seconds: %.3f\n", seconds);
+	printf("matches/sec: %.1f\n", matches / seconds);
+
+	for (int player = 0; player < VERSUS_PLAYERS; player++)
+	{
+		long wins = 0, lines = 0, garbage = 0, pieces = 0;
+
+		for (long match = 0; match < matches; match++)
+		{
+			wins += (results[match].winner == player) ? 1 : 0;
+			lines += results[match].players[player].num_lines;
+			garbage += results[match].garbage_sent[player];
+			pieces += results[match].players[player].pieces;
+		}
+
+		printf("player %d (%s): wins %ld lines %.2f garbage %.2f pieces %.2f\n", player + 1,
+			names[player], wins, (double)lines / matches, (double)garbage / matches,
+			(double)pieces / matches);
+	}
+
+	for (long match = 0; match < matches; match++)
+	{
+		draws += (results[match].winner < 0) ? 1 : 0;
+	}
+	printf("draws: %ld\n", draws);
+
+	free(results);
+	return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef LEARNTRIS_VERSUS_H
+#define LEARNTRIS_VERSUS_H
+
+#include "batch.h"
+#include "platform.h"
+
+// messages a player can be ahead of its opponent's reading; must be a
+// power of two and more than the delay
+#define GARBAGE_QUEUE_SIZE 64
+#define VERSUS_DEFAULT_DELAY 3
+#define VERSUS_PLAYERS 2
+#define GARBAGE_COLOR blue
+
+// What one piece of a player sent: the garbage rows its line clears are
+// worth, or GARBAGE_OVER if the player couldn't play it.
+#define GARBAGE_OVER (-1)
+
+typedef struct tag_garbage_message
+{
+	int rows;
+} garbage_message;
+
+// Lock-free, from one player's thread to the other's. Each side only
+// writes its own count, on a cache line of its own.
+typedef struct tag_garbage_queue
+{
+	garbage_message messages[GARBAGE_QUEUE_SIZE];
+	shared_count written;
+	char written_line[64 - sizeof(shared_count)];
+	shared_count read;
+	char read_line[64 - sizeof(shared_count)];
+} garbage_queue;
+
+typedef struct tag_versus_config
+{
+	unsigned long seed;
+	int delay;				// pieces between a clear and its garbage landing
+	int max_pieces;			// per player, so that good policies terminate
+	move_policy policies[VERSUS_PLAYERS];
+	const void *policy_settings[VERSUS_PLAYERS];
+} versus_config;
+
+// One side of a match, run on a thread of its own. Its game depends on
+// the opponent only through the messages, which are read by piece
+// number: message n lands just before the player's piece n + delay, so
+// how far apart the two threads run never changes the game.
+typedef struct tag_versus_player
+{
+	const versus_config *config;
+	int index;
+	long match;
+	search_context *search;
+	garbage_queue *outbox;			// written by this player
+	garbage_queue *inbox;			// written by the opponent
+	shared_count *stopped;			// this player's, set once it is done
+	shared_count *opponent_stopped;
+	int lost_at;					// the piece it couldn't play, or -1
+	int garbage_sent;
+	game_result result;
+} versus_player;
+
+// Two players and the queues between them, for a run of matches. Player
+// 1 keeps one thread from start_pair to stop_pair and is handed each
+// match in turn; player 0 plays on whichever thread calls play_match.
+typedef struct tag_versus_pair
+{
+	versus_player players[VERSUS_PLAYERS];
+	garbage_queue queues[VERSUS_PLAYERS];
+	shared_count stopped[VERSUS_PLAYERS];
+	shared_count posted;		// matches handed to player 1, stop_pair's too
+	shared_count finished;		// matches player 1 has played
+	bool quit;					// set before stop_pair's post
+	thread_handle thread;
+} versus_pair;
+
+typedef struct tag_versus_result
+{
+	int winner;				// the player still playing, -1 for a draw
+	game_result players[VERSUS_PLAYERS];
+	int garbage_sent[VERSUS_PLAYERS];
+} versus_result;
+
+bool start_pair(versus_pair *this_pair, const versus_config *config, search_context **searches);
+void play_match(versus_pair *this_pair, long match, versus_result *result);
+void stop_pair(versus_pair *this_pair);
+int versus_main(int argc, char *argv[]);
+
+#endif